@@ -9,10 +9,13 @@ protected:
 	Board board;
 public:
 	double elapsed = 0;
+	long long nodes = 0;
 	AI() = default;
 
 	AI(const Board& init) : board(init) {};
 
+	virtual ~AI() = default;
+
 	virtual void load_board(const Board& board_) {
 		board = board_;
 	}
@@ -37,6 +40,10 @@ public:
 	virtual void clear() {
 		board = Board();
 	}
+
+	// Called after the AI has moved: it may think on the opponent's time until the next call of
+	// any other method, which it returns from at once. Nothing by default.
+	virtual void ponder() {}
 };
 
 #include <stdlib.h>
@@ -55,10 +62,9 @@ public:
 		if (!board.has_candidate()) {
 			return Cell::Pass();
 		}
-		BitBoard candidate_board = board.get_candidates();
-		std::vector<Cell> candidates = all_cells(candidate_board);
+		auto candidates = board.get_candidate_list();
 		int idx = rand() % candidates.size();
-		Cell move = candidates[idx];
+		Cell move = candidates.at(idx);
 
 		end = std::chrono::system_clock::now();
 		elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -1,10 +1,39 @@
 #pragma once
 
 #include <thread>
+#include <chrono>
 #include <mutex>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 
 #include "AI.hpp"
+#include "SearchBoard.hpp"
+#include "TranspositionTable.hpp"
+#include "ParallelSearch.hpp"
+#include "Endgame.hpp"
+#include "ProbCut.hpp"
+#include "MoveOrdering.hpp"
+
+// Root searches of the iterative deepening with an aspiration window (all iterations but the
+// first), and how many fell outside of it.
+struct AspirationStats {
+	long long searches = 0;
+	long long fail_highs = 0;
+	long long fail_lows = 0;
+};
+
+// Replies of the opponent while the AI pondered, and whether it had expected them.
+struct PonderStats {
+	long long hits = 0;
+	long long misses = 0;
+};
+
+// How the search uses the threads of the pool.
+enum class Parallelism {
+	SPLIT,		// Young Brothers Wait: the threads share the subtrees of the nodes
+	LAZY_SMP	// helper threads search the same root on their own, sharing only the transposition table
+};
 
 class AlphaBetaAI : public AI {
 protected:
@@ -13,17 +42,84 @@ protected:
 	std::mutex mtx;
 	Cell move = Cell::Pass();
 	double depth_offset = 0.0;
+	std::atomic<long long> searched_nodes{ 0 };
+	TranspositionTable table;
+	Parallelism parallelism;
+	bool principal_variation = true;
+	static constexpr double TABLE_MIN_DEPTH = 2.0;
+
+	// Per-move budget of the iterative deepening search, 0 for none.
+	// Without any budget the search runs once at the fixed `depth`.
+	long long time_limit = 0;	// milliseconds
+	long long node_limit = 0;
+	std::chrono::steady_clock::time_point search_start;
+	std::atomic<bool> stopped{ false };
+
+	// With at most `endgame_empties` empty cells the root is solved exactly instead; with a budget
+	// and at most `wld_empties`, first as a win, loss or draw, in case the exact solve does not fit.
+	// 0 never.
+	int endgame_empties = 20;
+	int wld_empties = 22;
+	EndgameSolver endgame;
+
+	// Forward pruning, off until parameters fitted for the evaluation are loaded.
+	ProbCut probcut;
+
+	MoveOrdering ordering;
+	// weights of the killers and of the history on the scale of evaluate_child()
+	static constexpr int KILLER_WEIGHT = 16;
+	static constexpr int HISTORY_WEIGHT = 256;
+
+	// Aspiration windows of the iterative deepening: each iteration first searches the root within
+	// ASPIRATION_WIDTH times the usual change of the value from one iteration to the next, measured
+	// as the search goes, so that the windows fit the scale of any evaluation. A search failing
+	// high or low is repeated with the failing bound twice as far, then without it.
+	bool aspiration = true;
+	// running mean of the change of the root value between iterations, a property of the
+	// evaluation kept by clear()
+	double value_swing = 0;
+	AspirationStats aspiration_counts;
+	static constexpr double ASPIRATION_WIDTH = 1.0;
+	static constexpr int ASPIRATION_RETRIES = 3;
+
+	// Pondering: once it has moved, the AI searches the position after the reply it expects, in the
+	// background, until the opponent moves. On a hit the search of the move starts from the tables
+	// filled meanwhile; on a miss the pondering is stopped and the board taken back.
+	BackgroundThread background;
+	bool pondering = false;
+	bool ponder_hit = false;
+	Board ponder_from;				// the board before the expected reply
+	BitBoard ponder_move = 0x0LL;	// the expected reply, empty for a pass
+	PonderStats ponder_counts;
+
+	// Pondering goes on until stopped, whatever the budget.
+	bool has_budget() const { return !pondering && (time_limit > 0 || node_limit > 0); }
+
+	long long search_time() const {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - search_start).count();
+	}
+
+	// `visited`: nodes searched so far in this move. The clock is only read every 1024 nodes.
+	bool out_of_budget(const long long visited) const {
+		if (node_limit > 0 && visited >= node_limit) return true;
+		if (time_limit > 0 && (visited & 0x3ff) == 0) return search_time() >= time_limit;
+		return false;
+	}
 
-	static int evaluate_child(const Board& board, const Board& prev, const bool is_myturn) {
+	// Positions are keyed with the side to move, since values are from the point of view of this AI.
+	static BitBoard table_key(SearchBoard& board, const bool is_myturn) {
+		return is_myturn ? board.get_hash() : ~board.get_hash();
+	}
+
+	static int evaluate_child(SearchBoard& board, const bool is_myturn) {
 		const BitBoard& self_board = is_myturn ? board.get_self() : board.get_opponent();
 		const BitBoard& opponent_board = is_myturn ? board.get_opponent() : board.get_self();
 
 		const BitBoard empty = ~(self_board | opponent_board);
 
-		const BitBoard& self_candidates = is_myturn ? board.get_candidates() : prev.get_candidates();
-		const BitBoard& opponent_candidates = is_myturn ? prev.get_candidates() : board.get_candidates();
+		const BitBoard opponent_candidates = is_myturn ? board.get_prev_candidates() : board.get_candidates();
 
-		const BitBoard diff = board.get_opponent() ^ prev.get_self();
+		const BitBoard diff = board.get_last_played();
 
 		const int n_diff_open = openness(diff, empty);
 
@@ -37,27 +133,29 @@ protected:
 		return -num_cand - 3 * num_cornoer + 4 * open;
 	}
 
-	static std::vector<Board> sorted_children(const Board& board, const bool is_myturn) {
-		auto candidates = board.get_candidate_list();
+	// Children in search order, best first for the player to move: `table_move` (empty if none),
+	// then by evaluate_child() raised for the killers and by the history.
+	void sorted_children(SearchBoard& board, const bool is_myturn, ChildList& children, const BitBoard& table_move = 0x0LL) {
+		board.generate_children(children);
+		if (children.size() == 1) return;
 
-		if (candidates.empty()) {
-			return std::vector<Board>({ board.pass() });
-		}
-		else {
-			std::vector<Board> children(candidates.size());
-			size_t idx = 0;
-			for (auto& cell : candidates) {
-				children[idx++] = board.play(cell);
-			}
-			std::sort(children.begin(), children.end(),
-				[board, is_myturn](const Board& a, const Board& b) {
-					return evaluate_child(a, board, !is_myturn) > evaluate_child(b, board, !is_myturn);
-				});
-			return children;
+		for (auto& child : children) {
+			board.do_move_with_candidates(child);
+			// evaluate_child() scores the moves of the opponent from the point of view of this AI
+			const int score = evaluate_child(board, !is_myturn);
+			child.score = is_myturn ? score : -score;
+			board.undo_move();
 		}
+		ordering.sort(children, count_stones(~(board.get_self() | board.get_opponent())), board.get_ply(), table_move, { KILLER_WEIGHT, HISTORY_WEIGHT });
+	}
+
+	// `child`, the idx-th searched, cut off the node.
+	void record_cutoff(SearchBoard& board, const SearchMove& child, const int idx, const double depth) {
+		ordering.local().cutoff(child.move, count_stones(~(board.get_self() | board.get_opponent())), board.get_ply(),
+			std::max(1, (int)depth), idx == 0);
 	}
 
-	virtual double evaluate(const Board& board, const Board& prev, const bool is_myturn) {
+	virtual double evaluate(SearchBoard& board, const bool is_myturn) {
 
 		const BitBoard& self_board = is_myturn ? board.get_self() : board.get_opponent();
 		const BitBoard& opponent_board = is_myturn ? board.get_opponent() : board.get_self();
@@ -74,8 +172,14 @@ protected:
 			else return 0;
 		}
 
-		const BitBoard& self_candidates = is_myturn ? board.get_candidates() : prev.get_candidates();
-		const BitBoard& opponent_candidates = is_myturn ? prev.get_candidates() : board.get_candidates();
+		// this close to the end the exact score costs less than the evaluation
+		if (count_stones(empty) <= EndgameSolver::LAST_EMPTIES) {
+			const int score = EndgameSolver::solve_last(board.get_self(), board.get_opponent());
+			return endgame_value(is_myturn ? score : -score);
+		}
+
+		const BitBoard self_candidates = is_myturn ? board.get_candidates() : board.get_prev_candidates();
+		const BitBoard opponent_candidates = is_myturn ? board.get_prev_candidates() : board.get_candidates();
 
 		const int n_self_candidates = count_stones(self_candidates);
 		const int n_opponent_candidates = count_stones(opponent_candidates);
@@ -91,7 +195,7 @@ protected:
 		const int n_self_corner_cands = count_stones(self_candidates & corner);
 		const int n_opposite_corner_cands = count_stones(opponent_candidates & corner);
 
-		const BitBoard diff = board.get_opponent() ^ prev.get_self();
+		const BitBoard diff = board.get_last_played();
 
 		const int n_diff_open = openness(diff ^ (is_myturn ? opponent_fixed : self_fixed), empty);
 		const int n_self_open = openness(self_board ^ self_fixed, empty);
@@ -127,131 +231,624 @@ protected:
 		return score;
 	}
 
-	double alpha_beta(const Board& board, const Board& prev, const double depth, const bool is_myturn, double alpha, double beta) {
-		if (depth <= 0 || board.finished()) {
-			return evaluate(board, prev, is_myturn);
-		}
+	double search_child(SearchBoard& board, const SearchMove& child, const double depth, const bool is_myturn, double alpha, double beta, const SplitPoint* split) {
+		board.do_move_with_candidates(child);
+		const double value = alpha_beta(board, depth, is_myturn, alpha, beta, split);
+		board.undo_move();
+		return value;
+	}
 
-		std::vector<Board> children = sorted_children(board, is_myturn);
+	// Principal variation search of a move after the first: a null window only tells whether the
+	// move improves the bound of the node. If it does without a cutoff, the move is searched again
+	// between the bound it proved and the other bound. `is_myturn` is the side of the node.
+	double scout_child(SearchBoard& board, const SearchMove& child, const double depth, const bool is_myturn, double alpha, double beta, const SplitPoint* split) {
+		if (!principal_variation) return search_child(board, child, depth, !is_myturn, alpha, beta, split);
 
 		if (is_myturn) {
-			if (children.size() == 1) {
-				return std::max(alpha, alpha_beta(children.at(0), board, depth, !is_myturn, alpha, beta));
-			}
+			const double value = search_child(board, child, depth, !is_myturn, alpha, std::nextafter(alpha, beta), split);
+			if (value <= alpha || value >= beta) return value;
+			return search_child(board, child, depth, !is_myturn, std::nextafter(value, alpha), beta, split);
+		}
+		else {
+			const double value = search_child(board, child, depth, !is_myturn, std::nextafter(beta, alpha), beta, split);
+			if (value >= beta || value <= alpha) return value;
+			return search_child(board, child, depth, !is_myturn, alpha, std::nextafter(value, beta), split);
+		}
+	}
 
-			int idx = 0;
-			for (auto& child : children) {
-				if (idx < 2) {
-					alpha = std::max(alpha, alpha_beta(child, board, depth - 0.7, !is_myturn, alpha, beta));
-				}
-				else if (idx < 5) {
-					alpha = std::max(alpha, alpha_beta(child, board, depth - 1.0, !is_myturn, alpha, beta));
-				}
-				else if (idx < 8) {
-					alpha = std::max(alpha, alpha_beta(child, board, depth - 1.7, !is_myturn, alpha, beta));
-				}
-				else if (idx < 10) {
-					alpha = std::max(alpha, alpha_beta(child, board, depth - 2.3, !is_myturn, alpha, beta));
-				}
-				else {
-					alpha = std::max(alpha, alpha_beta(child, board, depth - 3.0, !is_myturn, alpha, beta));
-				}
-				idx++;
-				if (alpha >= beta) return alpha;
+	// The search below the node is useless, and its value meaningless.
+	bool aborted(const SplitPoint* split) const {
+		return stopped.load(std::memory_order_relaxed) || cut_off(split);
+	}
+
+	// Takes `value` of a child into the best value of the node, and raises alpha (lowers beta at
+	// the opponent's turn) with it. True if the bound moved.
+	static bool improve(const bool is_myturn, const double value, double& best, double& alpha, double& beta) {
+		if (is_myturn) {
+			best = std::max(best, value);
+			if (value > alpha) {
+				alpha = value;
+				return true;
 			}
-			return alpha;
 		}
 		else {
-			if (children.size() == 1) {
-				return std::min(beta, alpha_beta(children.at(0), board, depth, !is_myturn, alpha, beta));
+			best = std::min(best, value);
+			if (value < beta) {
+				beta = value;
+				return true;
 			}
-			std::reverse(children.begin(), children.end());
+		}
+		return false;
+	}
 
-			int idx = 0;
-			for (auto& child : children) {
-				if (idx < 2) {
-					beta = std::min(beta, alpha_beta(child, board, depth - 0.7, !is_myturn, alpha, beta));
+	// Multi-ProbCut: true, with the bound in `value`, if a shallow search predicts that the deep
+	// one would fail high or low.
+	bool probable_cutoff(SearchBoard& board, const double depth, const bool is_myturn, const double alpha, const double beta, const SplitPoint* split, double& value) {
+		const int empties = count_stones(~(board.get_self() | board.get_opponent()));
+		for (int check = 0; check < ProbCut::NUM_CHECKS; ++check) {
+			const ProbCutRegression* regression = probcut.find(is_myturn, empties, depth, check);
+			if (regression == nullptr || regression->a <= 0) continue;
+
+			const double shallow = ProbCut::shallow_depth(depth, check);
+			const double margin = probcut.threshold * regression->sigma;
+			if (beta < ProbCut::MAX_VALUE) {
+				const double bound = (beta + margin - regression->b) / regression->a;
+				if (alpha_beta(board, shallow, is_myturn, std::nextafter(bound, -HUGE_VAL), bound, split) >= bound) {
+					value = beta;
+					return true;
 				}
-				else if (idx < 5) {
-					beta = std::min(beta, alpha_beta(child, board, depth - 1.0, !is_myturn, alpha, beta));
-				}
-				else if (idx < 8) {
-					beta = std::min(beta, alpha_beta(child, board, depth - 1.7, !is_myturn, alpha, beta));
-				}
-				else if (idx < 10) {
-					beta = std::min(beta, alpha_beta(child, board, depth - 2.3, !is_myturn, alpha, beta));
-				}
-				else {
-					beta = std::min(beta, alpha_beta(child, board, depth - 3.0, !is_myturn, alpha, beta));
+			}
+			if (alpha > -ProbCut::MAX_VALUE) {
+				const double bound = (alpha - margin - regression->b) / regression->a;
+				if (alpha_beta(board, shallow, is_myturn, bound, std::nextafter(bound, HUGE_VAL), split) <= bound) {
+					value = alpha;
+					return true;
 				}
-				idx++;
-				if (alpha >= beta) return beta;
 			}
-			return beta;
+		}
+		return false;
+	}
+
+	// Fail-soft: the value may lie outside of the window, and is then a bound of the true value.
+	// `split`: the closest split point above the node, if any.
+	double alpha_beta(SearchBoard& board, const double depth, const bool is_myturn, double alpha, double beta, const SplitPoint* split) {
+		const long long visited = searched_nodes.fetch_add(1, std::memory_order_relaxed);
+		if (has_budget() && out_of_budget(visited)) stopped.store(true, std::memory_order_relaxed);
+		// the value of an interrupted search is discarded by the caller
+		if (aborted(split)) return is_myturn ? alpha : beta;
+
+		if (depth <= 0 || board.finished()) {
+			return evaluate(board, is_myturn);
+		}
+
+		// near the leaves a probe costs more than the search it could save
+		const bool use_table = depth >= TABLE_MIN_DEPTH;
+		const BitBoard key = use_table ? table_key(board, is_myturn) : 0x0LL;
+		TableEntry entry;
+		const bool found = use_table && table.probe(key, entry);
+		if (found && entry.covers(depth) && entry.cuts(alpha, beta)) return entry.value;
+		const double alpha_init = alpha, beta_init = beta;
+
+		double cutoff = 0;
+		if (probcut.enabled() && probable_cutoff(board, depth, is_myturn, alpha, beta, split, cutoff)) {
+			return aborted(split) ? (is_myturn ? alpha : beta) : cutoff;
 		}
 
+		ChildList children;
+		sorted_children(board, is_myturn, children, found ? entry.move : 0x0LL);
+
+		BitBoard best_move = 0x0LL;
+		double best = is_myturn ? -HUGE_VAL : HUGE_VAL;
+		for (int idx = 0; idx < (int)children.size(); ++idx) {
+			if (parallelism == Parallelism::SPLIT && should_split(idx, depth)) {
+				split_children(split, idx, (int)children.size(), alpha, beta,
+					[&](const int child_idx, const double child_alpha, const double child_beta, const SplitPoint* child_split) {
+						SearchBoard position(board, SearchBoard::CurrentPly());
+						return scout_child(position, children.at(child_idx), depth - child_reduction(child_idx), is_myturn, child_alpha, child_beta, child_split);
+					},
+					[&](const int child_idx, const double value) {
+						if (stopped.load(std::memory_order_relaxed)) return false;
+						const SearchMove& child = children.at(child_idx);
+						if (improve(is_myturn, value, best, alpha, beta)) best_move = child.move;
+						if (alpha < beta) return false;
+						record_cutoff(board, child, child_idx, depth);
+						return true;
+					});
+				break;
+			}
+			const SearchMove& child = children.at(idx);
+			const double child_depth = (children.size() == 1) ? depth : depth - child_reduction(idx);
+			const double value = (idx == 0)
+				? search_child(board, child, child_depth, !is_myturn, alpha, beta, split)
+				: scout_child(board, child, child_depth, is_myturn, alpha, beta, split);
+			if (improve(is_myturn, value, best, alpha, beta)) best_move = child.move;
+			if (alpha >= beta) {
+				if (children.size() > 1 && !aborted(split)) record_cutoff(board, child, idx, depth);
+				break;
+			}
+		}
+
+		const double value = best;
+		if (aborted(split)) return value;
+		if (use_table) table.store(key, value, depth, bound_of(value, alpha_init, beta_init), best_move);
+		return value;
 	}
 
 public:
-	AlphaBetaAI(const double depth_ = 8.0) : AI(), depth(depth_) {};
+	// `table_mb`: size of the transposition table shared by the search threads, 0 to disable it.
+	AlphaBetaAI(const double depth_ = 8.0, const size_t table_mb = 32, const Replacement replacement = Replacement::AGE_DEPTH,
+		const Parallelism parallelism_ = Parallelism::SPLIT)
+		: AI(), depth(depth_), table(table_mb, replacement), parallelism(parallelism_) {};
+
+	~AlphaBetaAI() { stop_pondering(); }
 
 	double eval() const override {
 		return evaluation;
 	}
 
-	void worker(const Board& child, const Board& board, const double depth)
+	// Searches a root move within (evaluation, beta); a value reaching beta cuts `root` off.
+	void worker(const SearchMove& child, const double depth, const bool first, const double beta, SplitPoint& root)
 	{
-		double tmp = alpha_beta(child, board, depth, false, evaluation, INT_MAX - 1);
+		double alpha;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			alpha = evaluation;
+		}
+
+		// the first move searched has no alpha to scout with
+		SearchBoard position(board);
+		double tmp = first
+			? search_child(position, child, depth, false, alpha, beta, &root)
+			: scout_child(position, child, depth, true, alpha, beta, &root);
+		if (aborted(&root)) return;
 
 		std::lock_guard<std::mutex> lock(mtx);
 		if (evaluation < tmp) {
 			evaluation = tmp;
-			move = Cell((child.get_opponent() | child.get_self()) ^ (board.get_opponent() | board.get_self()));
+			move = child.to_cell();
 		}
+		if (evaluation >= beta) root.cut();
 	}
 
-	Cell choose_move() override {
-		std::chrono::system_clock::time_point start, end;
-		start = std::chrono::system_clock::now();
+	// The first root moves are searched deeper.
+	static double root_depth(const int idx, const double depth) {
+		if (idx < 2) return depth + 0.5;
+		if (idx < 6) return depth;
+		return depth - 0.5;
+	}
 
-		auto children = sorted_children(board, true);
+	// One search of all root moves within the window (alpha, beta). Split: the first one alone, then
+	// the others in parallel with its value as alpha. Lazy SMP: all in sequence, the helpers provide
+	// the parallelism. The evaluation stays at alpha if the search fails low, and is only a lower
+	// bound if it fails high, the remaining moves being skipped.
+	void search_root(const ChildList& children, const double depth, const double alpha = INT_MIN + 1, const double beta = INT_MAX - 1) {
+		evaluation = alpha;
 
-		const int rest_turn = count_stones(~(board.get_opponent() | board.get_self()));
+		SplitPoint root(nullptr);
+		TaskGroup group;
+		int cnt = 0;
+		for (auto& child : children) {
+			const double child_depth = root_depth(cnt, depth);
+			const bool first = (cnt == 0);
+			if (first || parallelism == Parallelism::LAZY_SMP) worker(child, child_depth, first, beta, root);
+			else group.run([this, &child, child_depth, beta, &root] { worker(child, child_depth, false, beta, root); });
+			cnt++;
+		}
+		group.wait();
+	}
 
-		std::vector<std::thread> threads;
+	// Searches the root at `depth` with an aspiration window around `guess`, the value of the last
+	// iteration, widened until the value falls inside.
+	void search_aspirated(ChildList& children, const double depth, const double guess) {
+		double delta = ASPIRATION_WIDTH * value_swing;
+		// proven results have no usual change
+		const bool narrow = aspiration && delta > 0 && std::fabs(guess) < ProbCut::MAX_VALUE;
+		double alpha = narrow ? guess - delta : INT_MIN + 1;
+		double beta = narrow ? guess + delta : INT_MAX - 1;
+
+		for (int retry = 0; ; ++retry) {
+			aspiration_counts.searches++;
+			search_root(children, depth, alpha, beta);
+			if (stopped) return;
+
+			const bool fail_low = evaluation <= alpha && alpha > INT_MIN + 1;
+			const bool fail_high = evaluation >= beta && beta < INT_MAX - 1;
+			if (!fail_low && !fail_high) return;
+
+			delta *= 2;
+			if (fail_low) {
+				aspiration_counts.fail_lows++;
+				alpha = (retry + 1 < ASPIRATION_RETRIES) ? guess - delta : INT_MIN + 1;
+			}
+			else {
+				aspiration_counts.fail_highs++;
+				beta = (retry + 1 < ASPIRATION_RETRIES) ? evaluation + delta : INT_MAX - 1;
+				// the move which failed high is the best so far
+				auto best = std::find_if(children.begin(), children.end(), [&](const SearchMove& child) { return child.to_cell() == move; });
+				std::rotate(children.begin(), best, best + 1);
+			}
+		}
+	}
+
+	// Lazy SMP helper: iterative deepening of the root on its own, until `quit` is cut off.
+	// Only its entries in the transposition table are of use. Helpers start at alternate depths
+	// and with the root moves rotated, so that they do not all search the same nodes.
+	void helper(ChildList children, const int id, const double max_depth, const SplitPoint* quit) {
+		std::rotate(children.begin(), children.begin() + id % children.size(), children.end());
+
+		for (double iteration_depth = 1.0 + id % 2; iteration_depth <= max_depth; iteration_depth += 1.0) {
+			double alpha = INT_MIN + 1;
+			int cnt = 0;
+			for (auto& child : children) {
+				SearchBoard position(board);
+				const double value = (cnt > 0)
+					? scout_child(position, child, root_depth(cnt, iteration_depth), true, alpha, INT_MAX - 1, quit)
+					: search_child(position, child, root_depth(cnt, iteration_depth), false, alpha, INT_MAX - 1, quit);
+				if (aborted(quit)) return;
+				alpha = std::max(alpha, value);
+				cnt++;
+			}
+		}
+	}
+
+	// Iterative deepening until the budget runs out. Only completed iterations count, and the
+	// best move of each is searched first in the next one.
+	void search_iteratively(ChildList& children, const int rest_turn) {
+		Cell best_move = children.at(0).to_cell();
+		double best_evaluation = 0;
+
+		// deeper than the empties plus the largest reduction, every line ends with the game
+		for (double iteration_depth = 1.0; iteration_depth <= rest_turn + child_reduction(BOARD_AREA); iteration_depth += 1.0) {
+			if (completed_depth > 0) search_aspirated(children, iteration_depth, best_evaluation);
+			else search_root(children, iteration_depth);
+			if (stopped) break;
+
+			if (completed_depth > 0 && std::fabs(evaluation) < ProbCut::MAX_VALUE && std::fabs(best_evaluation) < ProbCut::MAX_VALUE) {
+				const double swing = std::fabs(evaluation - best_evaluation);
+				value_swing = (value_swing > 0) ? (3 * value_swing + swing) / 4 : swing;
+			}
+			best_move = move;
+			best_evaluation = evaluation;
+			completed_depth = iteration_depth;
+
+			auto best = std::find_if(children.begin(), children.end(), [&](const SearchMove& child) { return child.to_cell() == best_move; });
+			std::rotate(children.begin(), best, best + 1);
+
+			// the next iteration would not finish in the remaining time anyway
+			if (has_budget() && time_limit > 0 && 2 * search_time() > time_limit) break;
+		}
+
+		move = best_move;
+		evaluation = best_evaluation;
+	}
+
+	// Score of the endgame on the scale of evaluate(), winning above any midgame value. The score
+	// of a WLD solve is only its sign.
+	static double endgame_value(const int score) {
+		if (score > 0) return score + 100000;
+		if (score < 0) return score - 100000;
+		return 0;
+	}
+
+	void endgame_worker(const SearchMove& child, int& best, const EndgameMode mode) {
+		int alpha;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			alpha = best;
+		}
+
+		int score;
+		if (mode == EndgameMode::WLD) {
+			// nothing beats a win
+			if (alpha >= 1) return;
+			score = endgame.solve_move(board, child.move, std::max(alpha, -1), 1);
+			score = (score > 0) - (score < 0);
+		}
+		else {
+			score = (alpha >= -EndgameSolver::MAX_SCORE)
+				? endgame.scout_move(board, child.move, alpha)
+				: endgame.solve_move(board, child.move);
+		}
+		if (endgame.aborted()) return;
 
-		evaluation = INT_MIN + 1;
+		std::lock_guard<std::mutex> lock(mtx);
+		if (best < score) {
+			best = score;
+			move = child.to_cell();
+		}
+	}
 
-		if (rest_turn == 12) depth_offset += 2.0;
+	// Solves the root to the end of the game: the first move alone, then the others in parallel
+	// with null windows around the best score so far.
+	void solve_root(const ChildList& children, const EndgameMode mode) {
+		endgame.new_search();
+		endgame.reset_nodes();
 
+		int best = -EndgameSolver::MAX_SCORE - 1;
+		TaskGroup group;
 		int cnt = 0;
 		for (auto& child : children) {
-			if (cnt < 2) {
-				threads.push_back(std::thread(&AlphaBetaAI::worker, this, child, board, depth + depth_offset + 0.5));
-			}
-			else if (cnt < 6) {
-				threads.push_back(std::thread(&AlphaBetaAI::worker, this, child, board, depth + depth_offset));
-			}
-			else {
-				threads.push_back(std::thread(&AlphaBetaAI::worker, this, child, board, depth + depth_offset - 0.5));
-			}
+			if (cnt == 0) endgame_worker(child, best, mode);
+			else group.run([this, &child, &best, mode] { endgame_worker(child, best, mode); });
 			cnt++;
 		}
+		group.wait();
 
-		for (auto& thd : threads)
-		{
-			thd.join();
+		evaluation = endgame_value(best);
+		searched_nodes += endgame.nodes();
+	}
+
+	// Exact solve within `endgame_empties`. With a budget, a WLD solve within `wld_empties` comes
+	// first with half of it, then the exact one, if in range, with what is left; an exact solve out
+	// of budget falls back to the WLD result. A lost WLD solve scores every move alike, so then the
+	// exact solve only gets half of what is left, and the search the rest if it does not finish.
+	// False if the search is to choose the move: the WLD solve ran out, or lost without an exact one.
+	bool solve_endgame(const ChildList& children, const int rest_turn) {
+		const bool exact = rest_turn <= endgame_empties;
+		if (!has_budget()) {
+			endgame.set_budget(0, 0);
+			solve_root(children, EndgameMode::EXACT);
+			return true;
+		}
+
+		endgame.set_budget(time_limit / 2, node_limit / 2);
+		solve_root(children, EndgameMode::WLD);
+		if (endgame.aborted()) return false;
+		const bool lost = evaluation < 0;
+		if (!exact) return !lost;
+
+		const Cell wld_move = move;
+		const double wld_evaluation = evaluation;
+		const int share = lost ? 2 : 1;
+		endgame.set_budget(time_limit > 0 ? std::max(1LL, (time_limit - search_time()) / share) : 0,
+			node_limit > 0 ? std::max(1LL, (node_limit - searched_nodes) / share) : 0);
+		solve_root(children, EndgameMode::EXACT);
+		if (endgame.aborted()) {
+			if (lost) return false;
+			move = wld_move;
+			evaluation = wld_evaluation;
 		}
+		return true;
+	}
+
+	// Loads the Multi-ProbCut parameters fitted by ProbCutFit for the evaluation of this AI. False,
+	// and no pruning, if the file cannot be read.
+	bool load_probcut(const std::string& path) {
+		return probcut.load(path);
+	}
+
+	void disable_probcut() {
+		probcut.disable();
+	}
+
+	// Cut when the deep value is predicted beyond the bound by more than `deviations`.
+	void set_probcut_threshold(const double deviations) {
+		probcut.threshold = deviations;
+	}
+
+	// Value of `board` for the AI, by one search of `depth` with the full window; `is_myturn`: the AI
+	// is the player to move.
+	double search_value(const Board& board_, const double depth, const bool is_myturn = true) {
+		searched_nodes = 0;
+		stopped = false;
+		SearchBoard position(board_);
+		return alpha_beta(position, depth, is_myturn, -HUGE_VAL, HUGE_VAL, nullptr);
+	}
+
+	// Cutoffs of the searches since the last reset_ordering_stats(), and how many the first move
+	// made, to measure the move ordering. The endgame solves are not counted.
+	OrderingStats ordering_stats() const {
+		return ordering.stats();
+	}
+
+	void reset_ordering_stats() {
+		ordering.reset_stats();
+	}
+
+	// Aspiration windows in the iterative deepening (on by default), or the full window.
+	void set_aspiration(const bool enabled) {
+		aspiration = enabled;
+	}
+
+	// Root searches and failures of the aspiration windows since the last reset_aspiration_stats().
+	const AspirationStats& aspiration_stats() const {
+		return aspiration_counts;
+	}
+
+	void reset_aspiration_stats() {
+		aspiration_counts = AspirationStats();
+	}
 
+	// Principal variation search (on by default), or every move with the full window.
+	void set_principal_variation(const bool enabled) {
+		principal_variation = enabled;
+	}
+
+	// Depth of the last completed iteration of an iterative deepening search.
+	double completed_depth = 0;
+
+	// Searches each move by iterative deepening within `milliseconds`, instead of at the fixed depth.
+	void set_time_limit(const long long milliseconds) {
+		time_limit = milliseconds;
+	}
+
+	// Same with a budget of searched nodes per move.
+	void set_node_limit(const long long nodes_) {
+		node_limit = nodes_;
+	}
+
+	// Solves the game exactly from `empties` empty cells on, and with a budget as a win, loss or
+	// draw from `wld` on (by default 2 more); 0 to always search with the evaluation.
+	void set_endgame_empties(const int empties, const int wld = -1) {
+		endgame_empties = empties;
+		wld_empties = (wld < 0) ? ((empties > 0) ? empties + 2 : 0) : std::max(wld, empties);
+	}
+
+	Cell choose_move() override {
+		stop_pondering();
+
+		std::chrono::system_clock::time_point start, end;
+		start = std::chrono::system_clock::now();
+
+		SearchBoard root(board);
+		ChildList children;
+		sorted_children(root, true, children);
+
+		const int rest_turn = count_stones(~(board.get_opponent() | board.get_self()));
+
+		searched_nodes = 0;
+		stopped = false;
+		search_start = std::chrono::steady_clock::now();
+		completed_depth = 0;
+		// after a hit the entries of the pondering belong to this search
+		if (!ponder_hit) {
+			table.new_search();
+			ordering.new_search();
+		}
+		ponder_hit = false;
+
+		const bool solving = rest_turn <= (has_budget() ? wld_empties : endgame_empties);
+
+		// one helper per other thread of the pool for the search, stopped once it is over
+		SplitPoint quit(nullptr);
+		TaskGroup helpers;
+		const auto start_helpers = [&] {
+			if (parallelism != Parallelism::LAZY_SMP) return;
+			for (int id = 1; id < helpers.pool_size(); ++id) {
+				helpers.run([this, children, id, rest_turn, &quit] { helper(children, id, rest_turn + child_reduction(BOARD_AREA), &quit); });
+			}
+		};
+
+		if (solving && solve_endgame(children, rest_turn)) {
+			completed_depth = rest_turn;
+		}
+		else if (has_budget()) {
+			// also when the solve did not fit in the budget
+			start_helpers();
+			search_iteratively(children, rest_turn);
+		}
+		else {
+			start_helpers();
+			if (rest_turn == 12) depth_offset += 2.0;
+			search_root(children, depth + depth_offset);
+		}
+
+		quit.cut();
+		helpers.wait();
 
 		end = std::chrono::system_clock::now();
 		elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		nodes = searched_nodes;
 
 		return move;
 	}
 
+	// The reply expected from the opponent, to move on `board`: the best move of the transposition
+	// table or of the endgame solver, else the first in move order. Empty for a pass.
+	BitBoard predicted_reply() {
+		if (!board.has_candidate()) return 0x0LL;
+		SearchBoard root(board);
+		TableEntry entry;
+		if (table.probe(table_key(root, false), entry) && board.is_valid_move(entry.move)) return entry.move;
+		const BitBoard solved = endgame.best_move(board);
+		if (board.is_valid_move(solved)) return solved;
+
+		ChildList children;
+		sorted_children(root, false, children);
+		return children.at(0).move;
+	}
+
+	// Search of the background thread: as choose_move() without budget nor helpers, until stopped.
+	void ponder_search() {
+		SearchBoard root(board);
+		ChildList children;
+		sorted_children(root, true, children);
+
+		const int rest_turn = count_stones(~(board.get_opponent() | board.get_self()));
+
+		searched_nodes = 0;
+		search_start = std::chrono::steady_clock::now();
+		completed_depth = 0;
+		table.new_search();
+		ordering.new_search();
+
+		if (rest_turn <= endgame_empties) solve_root(children, EndgameMode::EXACT);
+		else search_iteratively(children, rest_turn);
+	}
+
+	// Stops the background search, if any, and takes the board back to before the expected reply.
+	void stop_pondering() {
+		if (!pondering) return;
+		stopped = true;
+		endgame.stop();
+		background.join();
+		pondering = false;
+		board = ponder_from;
+	}
+
+	// The opponent played `reply`, empty for a pass.
+	void opponent_replied(const BitBoard& reply) {
+		ponder_hit = pondering && reply == ponder_move;
+		if (pondering) {
+			if (ponder_hit) ponder_counts.hits++;
+			else ponder_counts.misses++;
+		}
+		stop_pondering();
+	}
+
+	void ponder() override {
+		stop_pondering();
+		ponder_hit = false;
+		if (board.finished()) return;
+
+		ponder_from = board;
+		ponder_move = predicted_reply();
+		board = is_empty(ponder_move) ? board.pass() : board.play(ponder_move);
+		// nothing to think about if the AI has to pass
+		if (!board.has_candidate()) {
+			board = ponder_from;
+			return;
+		}
+
+		// reset before the thread starts, so that no stop is lost
+		stopped = false;
+		endgame.set_budget(0, 0);
+		pondering = true;
+		background.start([this] { ponder_search(); });
+	}
+
+	void play(const Cell& move) override {
+		opponent_replied(move.is_pass() ? 0x0LL : from_cell(move));
+		AI::play(move);
+	}
+
+	void pass() override {
+		opponent_replied(0x0LL);
+		AI::pass();
+	}
+
+	void load_board(const Board& board_) override {
+		stop_pondering();
+		ponder_hit = false;
+		AI::load_board(board_);
+	}
+
+	// Replies of the opponent while pondering since the last reset_ponder_stats().
+	const PonderStats& ponder_stats() const {
+		return ponder_counts;
+	}
+
+	void reset_ponder_stats() {
+		ponder_counts = PonderStats();
+	}
+
 	void clear() override {
+		stop_pondering();
+		ponder_hit = false;
 		evaluation = 0;
 		move = Cell::Pass();
+		table.clear();
+		ordering.clear();
+		endgame.clear();
 	}
 };
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <iostream>
+
+#include "Benchmark.hpp"
+
+void print_usage() {
+	std::cout << "usage: Benchmark stability [-n positions] [-r repeats] [-s seed]\n"
+		<< "       Benchmark search [-n positions] [-d depth | -t milliseconds] [-p probcut] [-s seed]\n"
+		<< "       Benchmark endgame [-f suite] [-n positions] [-e empties] [-w] [-s seed]\n"
+		<< "       Benchmark mcts [-n positions] [-t milliseconds] [-u] [-l] [-s seed]\n"
+		<< "  stability  calculate_fixed_stones per game phase\n"
+		<< "  search     AlphaBetaAI nodes, time and cutoffs on the first move per parallel backend, with and without PVS, empties 20-60\n"
+		<< "  endgame    exact solves of a test suite, or of random positions if none is given\n"
+		<< "  mcts       MCTSAI playouts per thread count, then AlphaBetaAI at equal time, empties 20-60\n"
+		<< "  -n  positions per phase (default 20000 for stability, 10 for search and endgame)\n"
+		<< "  -r  repeats over the positions (default 50)\n"
+		<< "  -d  search depth (default 7)\n"
+		<< "  -t  iterative deepening within a time per position instead, with the aspiration window failures;\n"
+		<< "      for mcts, the time per position (default 100)\n"
+		<< "  -p  Multi-ProbCut parameters fitted by ProbCutFit for AlphaBetaAI (default none)\n"
+		<< "  -f  endgame test suite, one position per line as in load_endgame_suite()\n"
+		<< "  -e  empties of the random endgame positions (default 20)\n"
+		<< "  -w  win/loss/draw solves instead of exact scores\n"
+		<< "  -u  UCT instead of PUCT\n"
+		<< "  -l  leaf values from the network of DLAlphaBetaAI instead of random playouts\n"
+		<< "  -s  random seed (default 1)\n";
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		print_usage();
+		return 1;
+	}
+	const std::string mode = argv[1];
+
+	size_t per_phase = (mode == "stability") ? 20000 : 10;
+	int repeats = 50;
+	double depth = 7.0;
+	long long time_limit = 0;
+	unsigned int seed = 1;
+	int empties = 20;
+	std::string suite;
+	std::string probcut;
+	EndgameMode endgame_mode = EndgameMode::EXACT;
+	TreePolicy policy = TreePolicy::PUCT;
+	LeafValue leaf_value = LeafValue::PLAYOUT;
+
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "-n" && has_value) per_phase = (size_t)std::stoul(argv[++i]);
+		else if (arg == "-r" && has_value) repeats = std::stoi(argv[++i]);
+		else if (arg == "-d" && has_value) depth = std::stod(argv[++i]);
+		else if (arg == "-t" && has_value) time_limit = std::stoll(argv[++i]);
+		else if (arg == "-s" && has_value) seed = (unsigned int)std::stoul(argv[++i]);
+		else if (arg == "-e" && has_value) empties = std::stoi(argv[++i]);
+		else if (arg == "-f" && has_value) suite = argv[++i];
+		else if (arg == "-p" && has_value) probcut = argv[++i];
+		else if (arg == "-w") endgame_mode = EndgameMode::WLD;
+		else if (arg == "-u") policy = TreePolicy::UCT;
+		else if (arg == "-l") leaf_value = LeafValue::NETWORK;
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (mode == "stability") {
+		const auto phases = random_positions(per_phase, seed);
+		for (int phase = NUM_PHASES - 1; phase >= 0; --phase) {
+			const StabilityResult result = bench_stability(phases[phase], repeats);
+			std::cout << phase_name(phase) << ": " << result.nanoseconds << " ns/call, " << result.stable << " stable stones" << std::endl;
+		}
+	}
+	else if (mode == "search") {
+		const auto phases = random_positions(per_phase, seed);
+		std::vector<Board> positions;
+		for (int phase = 2; phase < NUM_PHASES; ++phase) {
+			positions.insert(positions.end(), phases[phase].begin(), phases[phase].end());
+		}
+
+		struct Variant {
+			std::string name;
+			Parallelism parallelism;
+			bool principal_variation;
+		};
+		const Variant variants[] = {
+			{ "split, pvs", Parallelism::SPLIT, true },
+			{ "split, full window", Parallelism::SPLIT, false },
+			{ "lazy smp, pvs", Parallelism::LAZY_SMP, true },
+			{ "lazy smp, full window", Parallelism::LAZY_SMP, false }
+		};
+		std::cout << ThreadPool::shared().size() << " threads, " << positions.size() << " positions, ";
+		if (time_limit > 0) std::cout << time_limit << " ms each" << std::endl;
+		else std::cout << "depth " << depth << std::endl;
+		for (const auto& variant : variants) {
+			AlphaBetaAI ai(depth, 32, Replacement::AGE_DEPTH, variant.parallelism);
+			ai.set_principal_variation(variant.principal_variation);
+			ai.set_endgame_empties(0);
+			ai.set_time_limit(time_limit);
+			if (!probcut.empty() && !ai.load_probcut(probcut)) {
+				std::cout << "cannot read " << probcut << std::endl;
+				return 1;
+			}
+			const SearchResult result = bench_search(positions, ai);
+			const OrderingStats ordering = ai.ordering_stats();
+			std::cout << variant.name << ": " << result.nodes << " nodes, " << result.milliseconds << " ms, "
+				<< (long long)(result.nodes * 1000.0 / std::max(result.milliseconds, 1.0)) << " nodes/s, "
+				<< 100.0 * ordering.first_move_rate() << "% cutoffs on the first move";
+			if (time_limit > 0) {
+				const AspirationStats& aspiration = ai.aspiration_stats();
+				std::cout << ", " << aspiration.searches << " root searches, " << aspiration.fail_highs << " fail high, "
+					<< aspiration.fail_lows << " fail low";
+			}
+			std::cout << std::endl;
+		}
+	}
+	else if (mode == "endgame") {
+		const auto positions = suite.empty() ? endgame_positions(per_phase, empties, seed) : load_endgame_suite(suite);
+		if (positions.empty()) {
+			std::cout << "no position in " << suite << std::endl;
+			return 1;
+		}
+
+		EndgameSolver solver;
+		const EndgameResult result = bench_endgame(positions, solver, endgame_mode, std::cout);
+		std::cout << positions.size() << " positions: " << result.nodes << " nodes, " << result.milliseconds << " ms, "
+			<< (long long)(result.nodes * 1000.0 / std::max(result.milliseconds, 1.0)) << " nodes/s";
+		if (result.checked > 0) std::cout << ", " << result.checked - result.wrong << "/" << result.checked << " scores correct";
+		std::cout << ", " << 100.0 * solver.ordering_stats().first_move_rate() << "% cutoffs on the first move" << std::endl;
+	}
+	else if (mode == "mcts") {
+		const auto phases = random_positions(per_phase, seed);
+		std::vector<Board> positions;
+		for (int phase = 2; phase < NUM_PHASES; ++phase) {
+			positions.insert(positions.end(), phases[phase].begin(), phases[phase].end());
+		}
+		if (time_limit <= 0) time_limit = 100;
+
+		const int pool_size = ThreadPool::shared().size();
+		std::cout << pool_size << " threads, " << positions.size() << " positions, " << time_limit << " ms each, "
+			<< ((policy == TreePolicy::UCT) ? "uct" : "puct") << ", "
+			<< ((leaf_value == LeafValue::NETWORK) ? "network" : "playouts") << std::endl;
+
+		MCTSAI mcts(policy, leaf_value);
+		mcts.set_time_limit(time_limit);
+		SearchResult result;
+		double single_rate = 0;
+		for (int threads = 1; ; threads = std::min(threads * 2, pool_size)) {
+			mcts.set_threads(threads);
+			result = bench_search(positions, mcts);
+			const double rate = result.nodes * 1000.0 / std::max(result.milliseconds, 1.0);
+			if (threads == 1) single_rate = rate;
+			std::cout << "mcts, " << threads << " threads: " << result.nodes << " playouts, " << result.milliseconds << " ms, "
+				<< (long long)rate << " playouts/s, " << rate / std::max(single_rate, 1.0) << "x one thread" << std::endl;
+			if (threads == pool_size) break;
+		}
+
+		AlphaBetaAI alpha_beta;
+		alpha_beta.set_endgame_empties(0);
+		alpha_beta.set_time_limit(time_limit);
+		const SearchResult reference = bench_search(positions, alpha_beta);
+		std::cout << "alpha-beta: " << reference.nodes << " nodes, " << reference.milliseconds << " ms, "
+			<< (long long)(reference.nodes * 1000.0 / std::max(reference.milliseconds, 1.0)) << " nodes/s, same move as mcts in "
+			<< result.same_moves(reference) << "/" << positions.size() << " positions" << std::endl;
+	}
+	else {
+		print_usage();
+		return 1;
+	}
+}
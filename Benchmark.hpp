@@ -0,0 +1,205 @@
+#pragma once
+
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <sstream>
+
+#include "Board.hpp"
+#include "Game.hpp"
+#include "AlphaBetaAI.hpp"
+#include "MCTSAI.hpp"
+#include "Endgame.hpp"
+
+/**
+Micro-benchmarks
+
+Positions are sampled by random playouts from the initial position and grouped by the number of
+empty cells, so that the cost of each routine can be followed through the game.
+*/
+
+constexpr int NUM_PHASES = 6;	// empties 0-9, 10-19, ..., 50-60
+
+inline std::string phase_name(const int phase) {
+	return "empties " + std::to_string(phase * 10) + "-" + std::to_string((phase == NUM_PHASES - 1) ? BOARD_AREA - 4 : phase * 10 + 9);
+}
+
+inline int phase_of(const Board& board) {
+	return std::min(count_stones(~(board.get_self() | board.get_opponent())) / 10, NUM_PHASES - 1);
+}
+
+// `per_phase` random positions for each phase, reproducible from `seed`.
+std::vector<std::vector<Board>> random_positions(const size_t per_phase, const unsigned int seed) {
+	std::mt19937 engine(seed);
+	std::vector<std::vector<Board>> phases(NUM_PHASES);
+
+	size_t filled = 0;
+	while (filled < NUM_PHASES) {
+		Board board(init_black, init_white);
+		const int plies = (int)(engine() % BOARD_AREA);
+		for (int ply = 0; ply < plies && !board.finished(); ++ply) {
+			const auto candidates = board.get_candidate_list();
+			board = candidates.empty() ? board.pass() : board.play(candidates.at(engine() % candidates.size()));
+		}
+
+		auto& positions = phases[phase_of(board)];
+		if (positions.size() < per_phase) {
+			positions.push_back(board);
+			if (positions.size() == per_phase) filled++;
+		}
+	}
+	return phases;
+}
+
+struct StabilityResult {
+	double nanoseconds = 0;	// per call
+	double stable = 0;		// stable stones per position
+	BitBoard checksum = 0x0LL;	// keeps the timed calls from being optimized away
+};
+
+StabilityResult bench_stability(const std::vector<Board>& positions, const int repeats) {
+	StabilityResult result;
+
+	long long stable = 0;
+	for (const auto& board : positions) {
+		BitBoard self_fixed = 0x0LL, opponent_fixed = 0x0LL;
+		calculate_fixed_stones(board.get_self(), board.get_opponent(), self_fixed, opponent_fixed);
+		stable += count_stones(self_fixed | opponent_fixed);
+	}
+	result.stable = (double)stable / positions.size();
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int repeat = 0; repeat < repeats; ++repeat) {
+		for (const auto& board : positions) {
+			BitBoard self_fixed = 0x0LL, opponent_fixed = 0x0LL;
+			calculate_fixed_stones(board.get_self(), board.get_opponent(), self_fixed, opponent_fixed);
+			result.checksum ^= self_fixed ^ opponent_fixed;
+		}
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	result.nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / ((double)repeats * positions.size());
+	return result;
+}
+
+struct SearchResult {
+	long long nodes = 0;
+	double milliseconds = 0;
+	std::vector<Cell> moves;	// chosen in each position
+
+	// Positions where `other` chose the same move.
+	int same_moves(const SearchResult& other) const {
+		int count = 0;
+		for (size_t idx = 0; idx < moves.size() && idx < other.moves.size(); ++idx) {
+			if (moves[idx] == other.moves[idx]) count++;
+		}
+		return count;
+	}
+};
+
+// One choose_move of `ai` per position, each from an empty transposition table.
+SearchResult bench_search(const std::vector<Board>& positions, AI& ai) {
+	SearchResult result;
+	for (const auto& board : positions) {
+		ai.clear();
+		ai.load_board(board);
+		result.moves.push_back(ai.choose_move());
+		result.nodes += ai.nodes;
+		result.milliseconds += ai.elapsed;
+	}
+	return result;
+}
+
+struct EndgamePosition {
+	Board board;
+	bool has_score = false;	// the expected score is known
+	int score = 0;
+};
+
+// Endgame test suite, one position per line: 64 cells a1, b1, ..., h8 as 'X' (black), 'O' (white)
+// or '-', the colour to move, then optionally ';' and the exact score of the best move, e.g.
+// "--XXXXX--OOOXX-O-OOOOXOXOOOXXXOXOOOXXXOX-OOOOXX--OOOXXXX--OOOOX-- X; G8:+18".
+// Lines which do not parse are skipped.
+std::vector<EndgamePosition> load_endgame_suite(const std::string& path) {
+	std::vector<EndgamePosition> out;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		std::string cells, colour;
+		if (!(stream >> cells >> colour) || cells.size() != BOARD_AREA) continue;
+
+		BitBoard black = 0x0LL, white = 0x0LL;
+		for (int n = 0; n < BOARD_AREA; ++n) {
+			if (cells[n] == 'X' || cells[n] == 'x' || cells[n] == '*') black |= 0x1ULL << n;
+			if (cells[n] == 'O' || cells[n] == 'o') white |= 0x1ULL << n;
+		}
+		const bool black_to_move = colour[0] == 'X' || colour[0] == 'x' || colour[0] == '*' || colour[0] == 'B' || colour[0] == 'b';
+
+		EndgamePosition position;
+		position.board = black_to_move ? Board(black, white) : Board(white, black);
+		const size_t mark = line.find(':', line.find(';'));
+		if (line.find(';') != std::string::npos && mark != std::string::npos) {
+			std::istringstream score(line.substr(mark + 1));
+			position.has_score = (bool)(score >> position.score);
+		}
+		out.push_back(position);
+	}
+	return out;
+}
+
+// `count` positions with exactly `empties` empty cells, by random playouts reproducible from `seed`.
+std::vector<EndgamePosition> endgame_positions(const size_t count, const int empties, const unsigned int seed) {
+	std::mt19937 engine(seed);
+	std::vector<EndgamePosition> out;
+	while (out.size() < count) {
+		Board board(init_black, init_white);
+		while (!board.finished() && count_stones(~(board.get_self() | board.get_opponent())) > empties) {
+			const auto candidates = board.get_candidate_list();
+			board = candidates.empty() ? board.pass() : board.play(candidates.at(engine() % candidates.size()));
+		}
+		if (board.finished()) continue;
+
+		EndgamePosition position;
+		position.board = board;
+		out.push_back(position);
+	}
+	return out;
+}
+
+struct EndgameResult {
+	long long nodes = 0;
+	double milliseconds = 0;
+	int checked = 0;	// positions with an expected score
+	int wrong = 0;
+};
+
+// One solve per position, each from an empty transposition table. In WLD mode only the sign of
+// the expected score is checked.
+EndgameResult bench_endgame(const std::vector<EndgamePosition>& positions, EndgameSolver& solver, const EndgameMode mode, std::ostream& os) {
+	EndgameResult result;
+	for (size_t n = 0; n < positions.size(); ++n) {
+		const EndgamePosition& position = positions[n];
+		solver.clear();
+		solver.reset_nodes();
+
+		const auto start = std::chrono::steady_clock::now();
+		const int score = solver.solve(position.board, mode);
+		const auto end = std::chrono::steady_clock::now();
+		const double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+		result.nodes += solver.nodes();
+		result.milliseconds += milliseconds;
+		os << "#" << n + 1 << ": " << count_stones(~(position.board.get_self() | position.board.get_opponent())) << " empties, score " << score;
+		if (position.has_score) {
+			result.checked++;
+			const int expected = (mode == EndgameMode::WLD) ? (position.score > 0) - (position.score < 0) : position.score;
+			if (score != expected) {
+				result.wrong++;
+				os << " (expected " << expected << ")";
+			}
+		}
+		os << ", " << solver.nodes() << " nodes, " << milliseconds << " ms" << std::endl;
+	}
+	return result;
+}
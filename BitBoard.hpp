@@ -4,6 +4,10 @@
 #include <stdexcept>
 #include <iostream>
 #include <string>
+#include <iterator>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using BitBoard = unsigned long long;
 constexpr int BOARD_SIZE = 8;
@@ -13,34 +17,47 @@ inline bool is_empty(const BitBoard& board) {
 	return board == 0x0LL;
 }
 
+inline int count_stones(const BitBoard& board) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return (int)__popcnt64(board);
+#elif defined(_MSC_VER)
+	return (int)(__popcnt((unsigned int)board) + __popcnt((unsigned int)(board >> 32)));
+#else
+	return __builtin_popcountll(board);
+#endif
+}
+
+// Index of the lowest stone. `board` must not be empty.
+inline int lsb_loc(const BitBoard& board) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long loc;
+	_BitScanForward64(&loc, board);
+	return (int)loc;
+#elif defined(_MSC_VER)
+	unsigned long loc;
+	if (_BitScanForward(&loc, (unsigned long)board)) return (int)loc;
+	_BitScanForward(&loc, (unsigned long)(board >> 32));
+	return (int)loc + 32;
+#else
+	return __builtin_ctzll(board);
+#endif
+}
+
+// Index of the highest stone, 0 for an empty board.
 inline int msb_loc(const BitBoard& stone) {
-	BitBoard tmp = stone;
-	int ans = 0;
-	if (!is_empty(tmp >> 32)) {
-		tmp >>= 32;
-		ans += 32;
-	}
-	if (!is_empty(tmp >> 16)) {
-		tmp >>= 16;
-		ans += 16;
-	}
-	if (!is_empty(tmp >> 8)) {
-		tmp >>= 8;
-		ans += 8;
-	}
-	if (!is_empty(tmp >> 4)) {
-		tmp >>= 4;
-		ans += 4;
-	}
-	if (!is_empty(tmp >> 2)) {
-		tmp >>= 2;
-		ans += 2;
-	}
-	if (!is_empty(tmp >> 1)) {
-		tmp >>= 1;
-		ans += 1;
-	}
-	return ans;
+	if (is_empty(stone)) return 0;
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long loc;
+	_BitScanReverse64(&loc, stone);
+	return (int)loc;
+#elif defined(_MSC_VER)
+	unsigned long loc;
+	if (_BitScanReverse(&loc, (unsigned long)(stone >> 32))) return (int)loc + 32;
+	_BitScanReverse(&loc, (unsigned long)stone);
+	return (int)loc;
+#else
+	return BOARD_AREA - 1 - __builtin_clzll(stone);
+#endif
 }
 
 class Cell {
@@ -83,6 +100,12 @@ public:
 		return Cell();
 	};
 
+	static Cell At(const int& loc) {
+		Cell cell;
+		cell.loc = loc;
+		return cell;
+	};
+
 	bool is_pass() const {
 		return loc == -1;
 	}
@@ -170,25 +193,65 @@ BitBoard from_cells(const std::vector<Cell>& cells) {
 	return board;
 }
 
-static std::vector<Cell> all_cells(const BitBoard& board) {
-	std::vector<Cell> out;
-	auto tmp = board;
-	while (!is_empty(tmp)) {
-		Cell cell(tmp);
-		out.push_back(cell);
-		tmp ^= from_cell(cell);
+// Iterates over the stones of a BitBoard as Cells, lowest first, without allocating.
+class CellIterator {
+private:
+	BitBoard rest = 0x0LL;
+public:
+	using iterator_category = std::forward_iterator_tag;
+	using value_type = Cell;
+	using difference_type = std::ptrdiff_t;
+	using pointer = const Cell*;
+	using reference = Cell;
+
+	CellIterator() = default;
+
+	CellIterator(const BitBoard& board) : rest(board) {};
+
+	Cell operator*() const { return Cell::At(lsb_loc(rest)); }
+
+	CellIterator& operator++() {
+		rest &= rest - 1;
+		return *this;
 	}
-	return out;
-}
 
-inline int count_stones(const BitBoard& board) {
-	auto bmap = board;
-	bmap = (bmap & 0x5555555555555555LL) + ((bmap >> 1) & 0x5555555555555555LL);
-	bmap = (bmap & 0x3333333333333333LL) + ((bmap >> 2) & 0x3333333333333333LL);
-	bmap = (bmap & 0x0f0f0f0f0f0f0f0fLL) + ((bmap >> 4) & 0x0f0f0f0f0f0f0f0fLL);
-	bmap = (bmap & 0x00ff00ff00ff00ffLL) + ((bmap >> 8) & 0x00ff00ff00ff00ffLL);
-	bmap = (bmap & 0x0000ffff0000ffffLL) + ((bmap >> 16) & 0x0000ffff0000ffffLL);
-	return (bmap & 0x00000000ffffffffLL) + ((bmap >> 32) & 0x00000000ffffffffLL);
+	CellIterator operator++(int) {
+		CellIterator out = *this;
+		rest &= rest - 1;
+		return out;
+	}
+
+	bool operator==(const CellIterator& other) const { return rest == other.rest; }
+
+	bool operator!=(const CellIterator& other) const { return rest != other.rest; }
+};
+
+class CellRange {
+private:
+	BitBoard board = 0x0LL;
+public:
+	CellRange() = default;
+
+	CellRange(const BitBoard& board_) : board(board_) {};
+
+	CellIterator begin() const { return CellIterator(board); }
+
+	CellIterator end() const { return CellIterator(); }
+
+	bool empty() const { return is_empty(board); }
+
+	size_t size() const { return (size_t)count_stones(board); }
+
+	// n-th cell in iteration order, n < size()
+	Cell at(size_t n) const {
+		BitBoard rest = board;
+		for (; n > 0; --n) rest &= rest - 1;
+		return *CellIterator(rest);
+	}
+};
+
+inline CellRange all_cells(const BitBoard& board) {
+	return CellRange(board);
 }
 
 #define REPEAT_BITS(b) 0x ## b ## b ## b ## b ## b ## b ## b ## b ## LL
@@ -259,76 +322,161 @@ inline BitBoard translate(const BitBoard& board, const Direction& dir, const int
 	return out;
 }
 
-BitBoard calculate_candidates(const BitBoard& self, const BitBoard& opponent) {
-	BitBoard candidates = 0x0LL;
+constexpr int row_step(const Direction dir) {
+	return (dir == UP || dir == UP_LEFT || dir == UP_RIGHT) ? -1
+		: (dir == DOWN || dir == DOWN_LEFT || dir == DOWN_RIGHT) ? 1 : 0;
+}
 
-	BitBoard empty = ~(self | opponent);
+constexpr int column_step(const Direction dir) {
+	return (dir == LEFT || dir == UP_LEFT || dir == DOWN_LEFT) ? -1
+		: (dir == RIGHT || dir == UP_RIGHT || dir == DOWN_RIGHT) ? 1 : 0;
+}
 
-	for (auto dir : ALL_DIRS) {
-		BitBoard shifted = self;
-		while (!is_empty(shifted)) {
-			shifted = translate(shifted, dir) & opponent;
-			candidates |= translate(shifted, dir) & empty;
-		}
-	}
+constexpr BitBoard shift_mask(const Direction dir, const int n) {
+	return column_step(dir) < 0 ? LEFT_MASK[BOARD_SIZE - n]
+		: column_step(dir) > 0 ? RIGHT_MASK[BOARD_SIZE - n] : LEFT_MASK[BOARD_SIZE];
+}
+
+// Compile-time counterpart of translate(): shift<UP_LEFT, 2>(board) is a single shift and mask.
+template <Direction dir, int n = 1>
+inline BitBoard shift(const BitBoard& board) {
+	static_assert(0 < n && n < BOARD_SIZE, "shift width must be in [1, BOARD_SIZE)");
+	constexpr int offset = n * (BOARD_SIZE * row_step(dir) + column_step(dir));
+	constexpr BitBoard mask = shift_mask(dir, n);
+	return ((board << (offset > 0 ? offset : 0)) >> (offset < 0 ? -offset : 0)) & mask;
+}
+
+// Cells adjacent to `board` in any of the eight directions.
+inline BitBoard neighbours(const BitBoard& board) {
+	return shift<UP>(board) | shift<DOWN>(board)
+		| shift<LEFT>(board) | shift<RIGHT>(board)
+		| shift<UP_LEFT>(board) | shift<UP_RIGHT>(board)
+		| shift<DOWN_LEFT>(board) | shift<DOWN_RIGHT>(board);
+}
+
+// Exchanges the bits selected by `mask` with the bits `delta` places above them.
+inline BitBoard delta_swap(const BitBoard& board, const BitBoard& mask, const int delta) {
+	const BitBoard swapped = (board ^ (board >> delta)) & mask;
+	return board ^ swapped ^ (swapped << delta);
+}
 
-	return candidates;
+// Mirrors the board top to bottom: a1 <-> a8.
+inline BitBoard flip_vertical(const BitBoard& board) {
+#ifdef _MSC_VER
+	return _byteswap_uint64(board);
+#else
+	return __builtin_bswap64(board);
+#endif
 }
 
-inline void calculate_fixed_stones_helper(const BitBoard& self, const BitBoard& opponent, const BitBoard& empty, BitBoard& self_fixed, BitBoard& opponent_fixed,
-	const Direction& dir_1, const Direction& dir_2) {
+// Mirrors the board left to right: a1 <-> h1.
+inline BitBoard flip_horizontal(const BitBoard& board) {
+	BitBoard flipped = delta_swap(board, 0x5555555555555555LL, 1);
+	flipped = delta_swap(flipped, 0x3333333333333333LL, 2);
+	return delta_swap(flipped, 0x0f0f0f0f0f0f0f0fLL, 4);
+}
 
-	BitBoard fixed_1 = translate(empty, dir_1, 1) | empty;
-	fixed_1 |= translate(fixed_1, dir_1, 2);
-	fixed_1 |= translate(fixed_1, dir_1, 4);
+// Mirrors the board along the a1-h8 diagonal: b1 <-> a2.
+inline BitBoard flip_diagonal(const BitBoard& board) {
+	BitBoard flipped = delta_swap(board, 0x00000000f0f0f0f0LL, 28);
+	flipped = delta_swap(flipped, 0x0000cccc0000ccccLL, 14);
+	return delta_swap(flipped, 0x00aa00aa00aa00aaLL, 7);
+}
 
-	BitBoard fixed_2 = translate(empty, dir_2, 1) | empty;
-	fixed_2 |= translate(fixed_2, dir_2, 2);
-	fixed_2 |= translate(fixed_2, dir_2, 4);
+// The 8 symmetries of the board, as flags: flip_diagonal first, then flip_horizontal, then flip_vertical.
+constexpr int NUM_SYMMETRIES = 8;
+constexpr int SYMMETRY_HORIZONTAL = 1;
+constexpr int SYMMETRY_VERTICAL = 2;
+constexpr int SYMMETRY_DIAGONAL = 4;
 
-	BitBoard fixed_self_1 = translate(~self, dir_1, 1) | ~self;
-	fixed_self_1 |= translate(fixed_self_1, dir_1, 2);
-	fixed_self_1 |= translate(fixed_self_1, dir_1, 4);
+inline BitBoard transform(BitBoard board, const int symmetry) {
+	if (symmetry & SYMMETRY_DIAGONAL) board = flip_diagonal(board);
+	if (symmetry & SYMMETRY_HORIZONTAL) board = flip_horizontal(board);
+	if (symmetry & SYMMETRY_VERTICAL) board = flip_vertical(board);
+	return board;
+}
 
-	BitBoard fixed_self_2 = translate(~self, dir_2, 1) | ~self;
-	fixed_self_2 |= translate(fixed_self_2, dir_2, 2);
-	fixed_self_2 |= translate(fixed_self_2, dir_2, 4);
+// Undoes transform(board, symmetry).
+inline BitBoard inverse_transform(BitBoard board, const int symmetry) {
+	if (symmetry & SYMMETRY_VERTICAL) board = flip_vertical(board);
+	if (symmetry & SYMMETRY_HORIZONTAL) board = flip_horizontal(board);
+	if (symmetry & SYMMETRY_DIAGONAL) board = flip_diagonal(board);
+	return board;
+}
 
-	BitBoard fixed_opponent_1 = translate(~opponent, dir_1, 1) | ~opponent;
-	fixed_opponent_1 |= translate(fixed_opponent_1, dir_1, 2);
-	fixed_opponent_1 |= translate(fixed_opponent_1, dir_1, 4);
+// Opponent stones which can be sandwiched along each line. Masking the edge columns (and rows) keeps
+// the raw shifts below from wrapping around the board, so no per-direction mask is needed afterwards.
+constexpr BitBoard HORIZONTAL_INNER_MASK = 0x7e7e7e7e7e7e7e7eLL;
+constexpr BitBoard VERTICAL_INNER_MASK = 0x00ffffffffffff00LL;
+constexpr BitBoard DIAGONAL_INNER_MASK = 0x007e7e7e7e7e7e00LL;
+
+// Parallel-prefix (Kogge-Stone) fill of the opponent stones that continue from `from` along the line
+// `from << S, from << 2S, ...`. The fill is a fixed sequence of shifts, long enough for the longest
+// possible line of six opponent stones.
+template <int S>
+inline BitBoard fill_forward(const BitBoard& from, const BitBoard& inner) {
+	BitBoard line = inner & (from << S);
+	line |= inner & (line << S);
+	const BitBoard inner_2 = inner & (inner << S);
+	line |= inner_2 & (line << (2 * S));
+	line |= inner_2 & (line << (2 * S));
+	return line;
+}
 
-	BitBoard fixed_opponent_2 = translate(~opponent, dir_2, 1) | ~opponent;
-	fixed_opponent_2 |= translate(fixed_opponent_2, dir_2, 2);
-	fixed_opponent_2 |= translate(fixed_opponent_2, dir_2, 4);
+template <int S>
+inline BitBoard fill_backward(const BitBoard& from, const BitBoard& inner) {
+	BitBoard line = inner & (from >> S);
+	line |= inner & (line >> S);
+	const BitBoard inner_2 = inner & (inner >> S);
+	line |= inner_2 & (line >> (2 * S));
+	line |= inner_2 & (line >> (2 * S));
+	return line;
+}
 
-	self_fixed &= (~(fixed_1 | fixed_2)) | (~(fixed_self_1 & fixed_self_2));
-	opponent_fixed &= (~(fixed_1 | fixed_2)) | (~(fixed_opponent_1 & fixed_opponent_2));
+// All-ones if `board` has any stone, otherwise zero.
+inline BitBoard select_mask(const BitBoard& board) {
+	return 0x0ULL - (BitBoard)!is_empty(board);
 }
 
-void calculate_fixed_stones(const BitBoard& self, const BitBoard& opponent, BitBoard& self_fixed, BitBoard& opponent_fixed) {
-	BitBoard empty = ~(self | opponent);
-	self_fixed = self;
-	opponent_fixed = opponent;
+template <int S>
+inline BitBoard flipped_line(const BitBoard& move, const BitBoard& self, const BitBoard& inner) {
+	const BitBoard forward = fill_forward<S>(move, inner);
+	const BitBoard backward = fill_backward<S>(move, inner);
+	return (forward & select_mask((forward << S) & self)) | (backward & select_mask((backward >> S) & self));
+}
+
+template <int S>
+inline BitBoard candidates_line(const BitBoard& self, const BitBoard& inner) {
+	return (fill_forward<S>(self, inner) << S) | (fill_backward<S>(self, inner) >> S);
+}
+
+// Stones flipped when `self` plays `move`. `move` must be a single empty cell.
+inline BitBoard calculate_flipped(const BitBoard& self, const BitBoard& opponent, const BitBoard& move) {
+	const BitBoard horizontal = opponent & HORIZONTAL_INNER_MASK;
+	const BitBoard vertical = opponent & VERTICAL_INNER_MASK;
+	const BitBoard diagonal = opponent & DIAGONAL_INNER_MASK;
 
-	//Fixed for LR
-	calculate_fixed_stones_helper(self, opponent, empty, self_fixed, opponent_fixed, LEFT, RIGHT);
+	return flipped_line<1>(move, self, horizontal)
+		| flipped_line<BOARD_SIZE>(move, self, vertical)
+		| flipped_line<BOARD_SIZE - 1>(move, self, diagonal)
+		| flipped_line<BOARD_SIZE + 1>(move, self, diagonal);
+}
+
+BitBoard calculate_candidates(const BitBoard& self, const BitBoard& opponent) {
+	const BitBoard empty = ~(self | opponent);
 
-	//Fixed for UD
-	calculate_fixed_stones_helper(self, opponent, empty, self_fixed, opponent_fixed, UP, DOWN);
+	const BitBoard horizontal = opponent & HORIZONTAL_INNER_MASK;
+	const BitBoard vertical = opponent & VERTICAL_INNER_MASK;
+	const BitBoard diagonal = opponent & DIAGONAL_INNER_MASK;
 
-	//Fixed for UL-DR
-	calculate_fixed_stones_helper(self, opponent, empty, self_fixed, opponent_fixed, UP_LEFT, DOWN_RIGHT);
+	const BitBoard candidates = candidates_line<1>(self, horizontal)
+		| candidates_line<BOARD_SIZE>(self, vertical)
+		| candidates_line<BOARD_SIZE - 1>(self, diagonal)
+		| candidates_line<BOARD_SIZE + 1>(self, diagonal);
 
-	//Fixed for UR-DL
-	calculate_fixed_stones_helper(self, opponent, empty, self_fixed, opponent_fixed, UP_RIGHT, DOWN_LEFT);
+	return candidates & empty;
 }
 
 int openness(const BitBoard& board, const BitBoard& empty) {
-	const BitBoard translated = translate(board, UP) | translate(board, DOWN)
-		| translate(board, LEFT) | translate(board, RIGHT)
-		| translate(board, UP_LEFT) | translate(board, UP_RIGHT)
-		| translate(board, DOWN_LEFT) | translate(board, DOWN_RIGHT);
-
-	return count_stones(translated & empty);
+	return count_stones(neighbours(board) & empty);
 }
\ No newline at end of file
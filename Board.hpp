@@ -1,32 +1,21 @@
 #pragma once
 
 #include "BitBoard.hpp"
+#include "MoveKernel.hpp"
+#include "Stability.hpp"
 
+// A position is just the two stone sets (16 bytes). Candidates are not stored: they are
+// computed on demand, so boards which are only copied, stored or evaluated never pay for them.
 class Board {
 private:
 	BitBoard self = 0x0LL;
 	BitBoard opponent = 0x0LL;
-	BitBoard candidates = 0x0LL;
-
-	void update_candidates() {
-		candidates = 0x0LL;
-
-		BitBoard empty = ~(self | opponent);
-
-		for (auto dir : ALL_DIRS) {
-			BitBoard shifted = self;
-			while(!is_empty(shifted)) {
-				shifted = translate(shifted, dir) & opponent;
-				candidates |= translate(shifted, dir) & empty;
-			}
-		}
-	}
 
 public:
 	Board() = default;
 	
 	Board(const BitBoard& self_, const BitBoard& opponent_)
-		: self(self_), opponent(opponent_), candidates(calculate_candidates(self, opponent)) {};
+		: self(self_), opponent(opponent_) {};
 	
 	Board(const std::vector<std::vector<int>>& self_table, const std::vector<std::vector<int>>& opponent_table)
 		: Board(from_table(self_table), from_table(opponent_table)) {};
@@ -42,6 +31,7 @@ public:
 		char move_mark = (player == BLACK) ? 'a' : '+';
 
 		BitBoard self_fixed = 0x0LL, opponent_fixed = 0x0LL;
+		const BitBoard candidates = get_candidates();
 
 		if (display_fixed) {
 			calculate_fixed_stones(self, opponent, self_fixed, opponent_fixed);
@@ -90,30 +80,18 @@ public:
 	
 	BitBoard get_opponent() const { return opponent; }
 	
-	BitBoard get_candidates() const { return candidates; }
+	BitBoard get_candidates() const { return move_kernel.candidates(self, opponent); }
 
-	std::vector<Cell> get_candidate_list() const { return all_cells(candidates); }
+	CellRange get_candidate_list() const { return all_cells(get_candidates()); }
 	
-	bool has_candidate() const { return !is_empty(candidates); }
+	bool has_candidate() const { return !is_empty(get_candidates()); }
 	
 	bool is_valid_move(const BitBoard& move) const {
-		return !is_empty(move & candidates);
+		return !is_empty(move & get_candidates());
 	}
 
 	Board play(const BitBoard& move) const {
-		BitBoard flipped = 0x0LL;
-		for (auto dir : ALL_DIRS) {
-			BitBoard captured = 0x0LL;
-			BitBoard shifted = translate(move, dir);
-			while (!is_empty(shifted & opponent)) {
-				shifted &= opponent;
-				captured |= shifted;
-				shifted = translate(shifted, dir);
-			}
-			if (!is_empty(shifted & self)) {
-				flipped |= captured;
-			}
-		}
+		const BitBoard flipped = move_kernel.flipped(self, opponent, move);
 		return Board(opponent ^ flipped, self | move | flipped);
 	}
 
@@ -126,12 +104,13 @@ public:
 	}
 
 	bool finished() const {
-		if (!is_empty(candidates)) return false;
-		auto next_board = pass();
-		return is_empty(next_board.candidates);
+		if (has_candidate()) return false;
+		return !pass().has_candidate();
 	}
 };
 
+static_assert(sizeof(Board) == 2 * sizeof(BitBoard), "Board must stay a bare pair of bitboards");
+
 std::ostream& operator<<(std::ostream& os, const Board board) {
 	os << board.to_string(BLACK);
 	return os;
@@ -16,11 +16,12 @@ private:
 
 	int D, H1, H2;
 
-	int cnt_leaf = 0;
-	int cnt_definite_leaf = 0;
+	std::atomic<int> cnt_leaf{ 0 };
+	std::atomic<int> cnt_definite_leaf{ 0 };
 	bool depth_updated = false;
 
 	std::string data_path = "data\\weight\\data.txt";
+	std::string probcut_path = "data\\probcut\\dl.txt";	// written by ProbCutFit, optional
 
 	static void read_vector(std::istream& is, std::vector<double>& dst, size_t n) {
 		dst.resize(n);
@@ -54,9 +55,9 @@ private:
 		return dot_row(Wo, 0, H2, h2) + bo[0];
 	}
 
-	double evaluate(const Board& board, const Board& prev, const bool is_myturn) override {
+	double evaluate(SearchBoard& board, const bool is_myturn) override {
 		cnt_leaf++;
-		auto features = get_feature_params(board, prev, is_myturn);
+		auto features = get_feature_params(board, is_myturn);
 		if (features.size() == NUM_OF_FEATURES) {
 			return predict(features);
 		}
@@ -84,7 +85,9 @@ private:
 	}
 
 public:
-	DLAlphaBetaAI(const double depth_ = 6.0) : AlphaBetaAI(depth_) {
+	DLAlphaBetaAI(const double depth_ = 6.0, const size_t table_mb = 32, const Replacement replacement = Replacement::AGE_DEPTH,
+		const Parallelism parallelism_ = Parallelism::SPLIT)
+		: AlphaBetaAI(depth_, table_mb, replacement, parallelism_) {
 		std::ifstream file(data_path);
 
 		if (!file) throw std::runtime_error("cannot open data file");
@@ -96,6 +99,17 @@ public:
 		read_vector(file, b2, H2);
 		read_vector(file, Wo, H2);
 		read_vector(file, bo, 1);
+
+		load_probcut(probcut_path);
+	}
+
+	// the background search evaluates with the network, destroyed before the base
+	~DLAlphaBetaAI() { stop_pondering(); }
+
+	// Static value of `board` for the player to move, as at a leaf of the search. Thread-safe.
+	double value(const Board& board) {
+		SearchBoard position(board);
+		return evaluate(position, true);
 	}
 
 	Cell choose_move() override {
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+#include "Board.hpp"
+#include "Zobrist.hpp"
+#include "TranspositionTable.hpp"
+#include "MoveOrdering.hpp"
+
+/**
+Exact endgame solver
+
+Searches to the end of the game and returns the final disc difference for the player to move,
+the empty cells going to the winner. The search is a fail-soft negamax on the raw stone sets with
+null windows for all moves but the first one.
+
+Move ordering:
+- with many empties, fastest first: the moves leaving the opponent the fewest replies, and the
+  fewest empty cells next to our stones (its replies later on), corners before the other cells,
+  after the best move of the transposition table and with a small bonus for the killers (see
+  MoveOrdering, the ply being the number of empties; the history does not improve on this order);
+- near the end, parity: the moves into regions (quadrants) with an odd number of empties first,
+  so that the player to move tends to get the last move of each region.
+
+Stability cutoff: the stones of the opponent which can never be flipped bound the score from
+above, so a node whose alpha is already out of reach is cut without searching its moves.
+
+Nodes with many empties also go through a transposition table of their own (the scores are not on
+the scale of the midgame evaluations), which gives bounds and the best move to try first.
+
+The last few empties are solved by LastEmpties<N>, unrolled for each number of empties: the empty
+cells are kept in a small array and each move only computes the stones flipped at its own cell,
+without generating the candidates or the children. The last empty cell only counts its flips.
+*/
+
+enum class EndgameMode {
+	EXACT,	// the final disc difference
+	WLD		// win, loss or draw only: a search with the window (-1, 1)
+};
+
+// Score of a finished game for `self`: the disc difference, the empty cells going to the winner.
+inline int final_score(const BitBoard& self, const BitBoard& opponent) {
+	const int n_self = count_stones(self);
+	const int n_opponent = count_stones(opponent);
+	const int n_empty = BOARD_AREA - n_self - n_opponent;
+	if (n_self > n_opponent) return n_self - n_opponent + n_empty;
+	if (n_self < n_opponent) return n_self - n_opponent - n_empty;
+	return 0;
+}
+
+// Stones flipped by a move on the last empty cell. All the other cells are occupied, so a line
+// through the cell only depends on the stones of the player to move: the 8 cells of each of the four
+// lines are gathered into one byte and the flips of the byte are looked up.
+class LastFlips {
+private:
+	static constexpr BitBoard FILE_A = 0x0101010101010101ULL;
+	static constexpr BitBoard GATHER_FILE = 0x0102040810204080ULL;	// file A into the top byte, rank order
+
+	unsigned char flips[BOARD_SIZE][256];	// [cell in the line][own stones of the line]
+	BitBoard diagonal[BOARD_AREA];			// the a1-h8 diagonal through each cell
+	BitBoard anti_diagonal[BOARD_AREA];		// the h1-a8 one
+
+	// Flips of a line from the cell `pos`, the cells which are not in `line` holding opponent stones.
+	static int line_flips(const int pos, const int line) {
+		int out = 0;
+		for (int step = -1; step <= 1; step += 2) {
+			int run = 0, n = pos + step;
+			for (; 0 <= n && n < BOARD_SIZE && !((line >> n) & 1); n += step) run++;
+			if (0 <= n && n < BOARD_SIZE) out += run;
+		}
+		return out;
+	}
+
+	// Byte of the cells of `mask` (at most one per rank) in file order.
+	static int gather_ranks(const BitBoard& stones, const BitBoard& mask) {
+		return (int)(((stones & mask) * FILE_A) >> (BOARD_AREA - BOARD_SIZE));
+	}
+
+public:
+	LastFlips() {
+		for (int pos = 0; pos < BOARD_SIZE; ++pos) {
+			for (int line = 0; line < 256; ++line) {
+				flips[pos][line] = (unsigned char)line_flips(pos, line);
+			}
+		}
+		for (int loc = 0; loc < BOARD_AREA; ++loc) {
+			diagonal[loc] = anti_diagonal[loc] = 0x0LL;
+			for (int other = 0; other < BOARD_AREA; ++other) {
+				const int dx = other % BOARD_SIZE - loc % BOARD_SIZE, dy = other / BOARD_SIZE - loc / BOARD_SIZE;
+				if (dx == dy) diagonal[loc] |= 0x1ULL << other;
+				if (dx == -dy) anti_diagonal[loc] |= 0x1ULL << other;
+			}
+		}
+	}
+
+	// Number of stones flipped by the owner of `self` playing at `loc`, the only empty cell.
+	// Diagonals shorter than 8 cells read as opponent stones beyond their ends, which are never
+	// outflanked, so they need no special case.
+	int count(const BitBoard& self, const int loc) const {
+		const int x = loc % BOARD_SIZE, y = loc / BOARD_SIZE;
+		return flips[x][(self >> (BOARD_SIZE * y)) & 0xff]
+			+ flips[y][(((self >> x) & FILE_A) * GATHER_FILE) >> (BOARD_AREA - BOARD_SIZE)]
+			+ flips[x][gather_ranks(self, diagonal[loc])]
+			+ flips[x][gather_ranks(self, anti_diagonal[loc])];
+	}
+};
+
+static const LastFlips last_flips;
+
+// Alpha-beta search of a position with exactly N empty cells `locs`, in the order given.
+// `passed`: the opponent has just passed, so a pass ends the game.
+template <int N>
+struct LastEmpties {
+	static int solve(const BitBoard& self, const BitBoard& opponent, int alpha, const int beta, const int* locs, const bool passed, long long& nodes) {
+		nodes++;
+		int best = -BOARD_AREA - 1;
+		for (int idx = 0; idx < N; ++idx) {
+			const BitBoard move = 0x1ULL << locs[idx];
+			const BitBoard flipped = move_kernel.flipped(self, opponent, move);
+			if (is_empty(flipped)) continue;
+
+			int rest[N - 1];
+			for (int n = 0, k = 0; n < N; ++n) {
+				if (n != idx) rest[k++] = locs[n];
+			}
+			const int value = -LastEmpties<N - 1>::solve(opponent ^ flipped, self | move | flipped, -beta, -alpha, rest, false, nodes);
+			if (value > best) {
+				best = value;
+				if (value >= beta) return best;
+				alpha = std::max(alpha, value);
+			}
+		}
+		if (best > -BOARD_AREA - 1) return best;
+
+		if (passed) return final_score(self, opponent);
+		return -solve(opponent, self, -beta, -alpha, locs, true, nodes);
+	}
+};
+
+// The last empty cell is played by whoever can, and nobody else is left to move after.
+template <>
+struct LastEmpties<1> {
+	static int solve(const BitBoard& self, const BitBoard& opponent, int, int, const int* locs, bool, long long& nodes) {
+		nodes++;
+		const int score = 2 * count_stones(self) - BOARD_AREA + 1;	// disc difference before the last move
+
+		int flips = last_flips.count(self, locs[0]);
+		if (flips > 0) return score + 1 + 2 * flips;
+		flips = last_flips.count(opponent, locs[0]);
+		if (flips > 0) return score - 1 - 2 * flips;
+		return (score > 0) ? score + 1 : score - 1;
+	}
+};
+
+class EndgameSolver {
+private:
+	static constexpr int FASTEST_FIRST_EMPTIES = 6;	// fewer empties: parity ordering only
+	static constexpr int STABILITY_EMPTIES = 5;		// fewer empties: the cutoff costs more than it saves
+	static constexpr int TABLE_EMPTIES = 8;			// fewer empties: not worth a probe
+	static constexpr BitBoard CORNERS = 0x8100000000000081ULL;
+
+	std::atomic<long long> searched_nodes{ 0 };
+	TranspositionTable table;
+	MoveOrdering ordering;
+	// weights of the killers and of the history on the scale of the fastest first scores
+	static constexpr int KILLER_WEIGHT = 24;
+	static constexpr int HISTORY_WEIGHT = 0;
+
+	// Budget of the solves since set_budget(), 0 for none.
+	long long time_limit = 0;	// milliseconds
+	long long node_limit = 0;
+	std::chrono::steady_clock::time_point budget_start;
+	std::atomic<bool> stopped{ false };
+
+	// `visited`: nodes of the running solve not yet added to `searched_nodes`.
+	bool out_of_budget(const long long visited) {
+		if (node_limit > 0 && searched_nodes + visited >= node_limit) stopped = true;
+		if (time_limit > 0 && std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - budget_start).count() >= time_limit) stopped = true;
+		return stopped;
+	}
+
+	static BitBoard quadrant(const int idx) {
+		static const BitBoard quadrants[4] = {
+			0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL, 0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL
+		};
+		return quadrants[idx];
+	}
+
+	static int quadrant_of(const BitBoard& move) {
+		const int loc = lsb_loc(move);
+		return ((loc >> 4) & 2) | ((loc >> 2) & 1);
+	}
+
+	// One bit per quadrant holding an odd number of empties.
+	static int parity_of(const BitBoard& empty) {
+		int parity = 0;
+		for (int idx = 0; idx < 4; ++idx) {
+			parity |= (count_stones(empty & quadrant(idx)) & 1) << idx;
+		}
+		return parity;
+	}
+
+	static BitBoard odd_regions(const int parity) {
+		BitBoard out = 0x0LL;
+		for (int idx = 0; idx < 4; ++idx) {
+			if ((parity >> idx) & 1) out |= quadrant(idx);
+		}
+		return out;
+	}
+
+	// Upper bound of the score from the stable stones of the opponent, or BOARD_AREA if it cannot
+	// reach `alpha` anyway.
+	static int stability_bound(const BitBoard& self, const BitBoard& opponent, const int alpha) {
+		// even if every opponent stone were stable the bound would stay above alpha
+		if (BOARD_AREA - 2 * count_stones(opponent) > alpha) return BOARD_AREA;
+		BitBoard self_fixed = 0x0LL, opponent_fixed = 0x0LL;
+		calculate_fixed_stones(self, opponent, self_fixed, opponent_fixed);
+		return BOARD_AREA - 2 * count_stones(opponent_fixed);
+	}
+
+	int search_move(const BitBoard& self, const BitBoard& opponent, const BitBoard& move, const BitBoard& flipped,
+		const int alpha, const int beta, const int parity, long long& nodes) {
+		return -solve(opponent ^ flipped, self | move | flipped, -beta, -alpha, parity ^ (1 << quadrant_of(move)), false, nodes);
+	}
+
+	// Null window for all moves but the first; a move failing high inside the window is searched
+	// again from the value it proved.
+	int scout_move(const BitBoard& self, const BitBoard& opponent, const BitBoard& move, const BitBoard& flipped,
+		const int alpha, const int beta, const int parity, long long& nodes) {
+		const int value = search_move(self, opponent, move, flipped, alpha, alpha + 1, parity, nodes);
+		if (value <= alpha || value >= beta) return value;
+		return search_move(self, opponent, move, flipped, value - 1, beta, parity, nodes);
+	}
+
+	// `first`: move to search first, e.g. the best move from the table, if any.
+	int solve_sorted(const BitBoard& self, const BitBoard& opponent, const BitBoard& moves, const BitBoard& first,
+		int alpha, const int beta, const int parity, BitBoard& best_move, long long& nodes) {
+		ChildBatch batch;
+		move_kernel.children(self, opponent, moves, batch);
+
+		const BitBoard odd = odd_regions(parity);
+		const BitBoard empty = ~(self | opponent);
+		const int n_empty = count_stones(empty);
+		MoveHistory& tables = ordering.local();
+		int order[ChildBatch::CAPACITY];
+		int score[ChildBatch::CAPACITY];
+		for (int idx = 0; idx < batch.size; ++idx) {
+			const BitBoard replies = batch.candidates[idx];
+			int fastest = -16 * count_stones(replies) - 32 * count_stones(replies & CORNERS)
+				- 10 * openness(self | batch.move[idx] | batch.flipped[idx], empty ^ batch.move[idx]);
+			if (!is_empty(batch.move[idx] & CORNERS)) fastest += 64;
+			if (!is_empty(batch.move[idx] & odd)) fastest += 8;
+			score[idx] = tables.score(batch.move[idx], fastest, n_empty, n_empty, first, { KILLER_WEIGHT, HISTORY_WEIGHT });
+			order[idx] = idx;
+		}
+		std::sort(order, order + batch.size, [&](const int a, const int b) { return score[a] > score[b]; });
+
+		int best = -BOARD_AREA - 1;
+		for (int n = 0; n < batch.size; ++n) {
+			const int idx = order[n];
+			const int value = (n == 0)
+				? search_move(self, opponent, batch.move[idx], batch.flipped[idx], alpha, beta, parity, nodes)
+				: scout_move(self, opponent, batch.move[idx], batch.flipped[idx], alpha, beta, parity, nodes);
+			if (value > best) {
+				best = value;
+				best_move = batch.move[idx];
+			}
+			alpha = std::max(alpha, value);
+			if (alpha >= beta) {
+				if (batch.size > 1 && !stopped) tables.cutoff(batch.move[idx], n_empty, n_empty, n_empty, n == 0);
+				break;
+			}
+		}
+		return best;
+	}
+
+	int solve_parity(const BitBoard& self, const BitBoard& opponent, const BitBoard& moves, int alpha, const int beta, const int parity, long long& nodes) {
+		const BitBoard odd = odd_regions(parity);
+		const BitBoard groups[2] = { moves & odd, moves & ~odd };
+
+		int best = -BOARD_AREA - 1;
+		bool first = true;
+		for (BitBoard rest : groups) {
+			for (; !is_empty(rest); rest &= rest - 1) {
+				const BitBoard move = rest & (~rest + 1);
+				const BitBoard flipped = move_kernel.flipped(self, opponent, move);
+				const int value = first
+					? search_move(self, opponent, move, flipped, alpha, beta, parity, nodes)
+					: scout_move(self, opponent, move, flipped, alpha, beta, parity, nodes);
+				first = false;
+				best = std::max(best, value);
+				alpha = std::max(alpha, value);
+				if (alpha >= beta) return best;
+			}
+		}
+		return best;
+	}
+
+	// At most LAST_EMPTIES empty cells: the cells in odd regions are tried first.
+	static int solve_last(const BitBoard& self, const BitBoard& opponent, const int alpha, const int beta, const int parity, const bool passed, long long& nodes) {
+		const BitBoard empty = ~(self | opponent);
+		const BitBoard odd = odd_regions(parity);
+		const BitBoard groups[2] = { empty & odd, empty & ~odd };
+
+		int locs[LAST_EMPTIES];
+		int n_empty = 0;
+		for (BitBoard rest : groups) {
+			for (; !is_empty(rest); rest &= rest - 1) {
+				locs[n_empty++] = lsb_loc(rest);
+			}
+		}
+
+		switch (n_empty) {
+		case 1: return LastEmpties<1>::solve(self, opponent, alpha, beta, locs, passed, nodes);
+		case 2: return LastEmpties<2>::solve(self, opponent, alpha, beta, locs, passed, nodes);
+		case 3: return LastEmpties<3>::solve(self, opponent, alpha, beta, locs, passed, nodes);
+		case 4: return LastEmpties<4>::solve(self, opponent, alpha, beta, locs, passed, nodes);
+		default:
+			nodes++;
+			return final_score(self, opponent);
+		}
+	}
+
+	// `passed`: the opponent has just passed, so a pass ends the game.
+	int solve(const BitBoard& self, const BitBoard& opponent, int alpha, int beta, const int parity, const bool passed, long long& nodes) {
+		const BitBoard empty = ~(self | opponent);
+		const int n_empty = count_stones(empty);
+		if (n_empty <= LAST_EMPTIES) return solve_last(self, opponent, alpha, beta, parity, passed, nodes);
+
+		if (stopped) return 0;
+		nodes++;
+		const BitBoard moves = move_kernel.candidates(self, opponent);
+		if (is_empty(moves)) {
+			if (passed) return final_score(self, opponent);
+			return -solve(opponent, self, -beta, -alpha, parity, true, nodes);
+		}
+
+		if (n_empty >= STABILITY_EMPTIES) {
+			const int bound = stability_bound(self, opponent, alpha);
+			if (bound <= alpha) return bound;
+			beta = std::min(beta, bound);
+		}
+
+		if (n_empty < FASTEST_FIRST_EMPTIES) return solve_parity(self, opponent, moves, alpha, beta, parity, nodes);
+
+		const bool use_table = n_empty >= TABLE_EMPTIES;
+		// the budget is checked as seldom as the table is probed
+		if (use_table && (time_limit > 0 || node_limit > 0) && out_of_budget(nodes)) return 0;
+		const BitBoard key = use_table ? zobrist.hash(self, opponent) : 0x0LL;
+		TableEntry entry;
+		if (use_table && table.probe(key, entry) && entry.cuts(alpha, beta)) return (int)entry.value;
+
+		BitBoard best_move = 0x0LL;
+		const int value = solve_sorted(self, opponent, moves, entry.move, alpha, beta, parity, best_move, nodes);
+		if (use_table && !stopped) table.store(key, value, n_empty, bound_of(value, alpha, beta), best_move);
+		return value;
+	}
+
+public:
+	static constexpr int MAX_SCORE = BOARD_AREA;
+	static constexpr int LAST_EMPTIES = 4;	// at most as many empties: solved by LastEmpties
+
+	// Exact score of a position with at most LAST_EMPTIES empty cells for `self`, the player to move.
+	static int solve_last(const BitBoard& self, const BitBoard& opponent) {
+		long long nodes = 0;
+		return solve_last(self, opponent, -MAX_SCORE, MAX_SCORE, parity_of(~(self | opponent)), false, nodes);
+	}
+
+	// `table_mb`: size of the transposition table, 0 to disable it.
+	explicit EndgameSolver(const size_t table_mb = 16) : table(table_mb, Replacement::DEPTH) {};
+
+	// Exact score of `board` for the player to move. Fail-soft: a score outside of the window is
+	// only a bound (at most alpha, or at least beta).
+	int solve(const Board& board, const int alpha = -MAX_SCORE, const int beta = MAX_SCORE) {
+		long long nodes = 0;
+		const int value = solve(board.get_self(), board.get_opponent(), alpha, beta,
+			parity_of(~(board.get_self() | board.get_opponent())), false, nodes);
+		searched_nodes += nodes;
+		return value;
+	}
+
+	// Score of `board` in `mode`: in WLD mode 1 for a win, 0 for a draw and -1 for a loss.
+	int solve(const Board& board, const EndgameMode mode) {
+		if (mode == EndgameMode::EXACT) return solve(board);
+		const int value = solve(board, -1, 1);
+		return (value > 0) - (value < 0);
+	}
+
+	// Score of the move `move` of `board` (empty for a pass) for the player to move.
+	int solve_move(const Board& board, const BitBoard& move, const int alpha = -MAX_SCORE, const int beta = MAX_SCORE) {
+		const Board next = is_empty(move) ? board.pass() : board.play(move);
+		return -solve(next, -beta, -alpha);
+	}
+
+	// Same, with a null window first when `alpha` was already raised by another move.
+	int scout_move(const Board& board, const BitBoard& move, const int alpha, const int beta = MAX_SCORE) {
+		const int value = solve_move(board, move, alpha, alpha + 1);
+		if (value <= alpha || value >= beta) return value;
+		return solve_move(board, move, value - 1, beta);
+	}
+
+	// Limits the following solves to `milliseconds` from now and to nodes() reaching `nodes_`,
+	// 0 for no limit. A solve running out of budget returns a meaningless value and sets aborted().
+	void set_budget(const long long milliseconds, const long long nodes_) {
+		time_limit = milliseconds;
+		node_limit = nodes_;
+		budget_start = std::chrono::steady_clock::now();
+		stopped = false;
+	}
+
+	bool aborted() const { return stopped; }
+
+	// Aborts the running solves, from another thread, until the next set_budget().
+	void stop() { stopped = true; }
+
+	// Best move of `board` found by the earlier solves, empty if none.
+	BitBoard best_move(const Board& board) {
+		TableEntry entry;
+		if (!table.probe(zobrist.hash(board.get_self(), board.get_opponent()), entry)) return 0x0LL;
+		return entry.move;
+	}
+
+	long long nodes() const { return searched_nodes; }
+
+	void reset_nodes() { searched_nodes = 0; }
+
+	// Cutoffs of the nodes ordered fastest first since the last reset_ordering_stats(), and how
+	// many the first move made.
+	OrderingStats ordering_stats() const { return ordering.stats(); }
+
+	void reset_ordering_stats() { ordering.reset_stats(); }
+
+	// The entries of earlier solves are kept but replaced first.
+	void new_search() {
+		table.new_search();
+		ordering.new_search();
+	}
+
+	void clear() {
+		table.clear();
+		ordering.clear();
+	}
+};
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "Board.hpp"
+#include "SearchBoard.hpp"
 
 /**
 Feature parameters
@@ -76,20 +76,68 @@ inline double safe_div(const double a, const double b) {
 	return (a == 0) ? 0.0 : a / b;
 }
 
-std::vector<double> get_feature_params(const Board& current, const Board& prev, const bool is_myturn) {
+// Fills `board` towards `dir` by 1 + 2 + 4 cells, i.e. to the board edge.
+template <Direction dir>
+inline BitBoard fill_to_edge(const BitBoard& board) {
+	BitBoard filled = shift<dir, 1>(board) | board;
+	filled |= shift<dir, 2>(filled);
+	filled |= shift<dir, 4>(filled);
+	return filled;
+}
 
-	const BitBoard& my_board = is_myturn ? current.get_self() : current.get_opponent();
-	const BitBoard& opponent_board = is_myturn ? current.get_opponent() : current.get_self();
+template <Direction dir_1, Direction dir_2>
+inline void legacy_fixed_stones_helper(const BitBoard& self, const BitBoard& opponent, const BitBoard& empty, BitBoard& self_fixed, BitBoard& opponent_fixed) {
 
-	const BitBoard empty = ~(my_board | opponent_board);
+	const BitBoard fixed_1 = fill_to_edge<dir_1>(empty);
+	const BitBoard fixed_2 = fill_to_edge<dir_2>(empty);
 
-	const BitBoard& my_candidates = is_myturn ? current.get_candidates() : prev.get_candidates();
-	const BitBoard& opponent_candidates = is_myturn ? prev.get_candidates() : current.get_candidates();
+	const BitBoard fixed_self_1 = fill_to_edge<dir_1>(~self);
+	const BitBoard fixed_self_2 = fill_to_edge<dir_2>(~self);
+
+	const BitBoard fixed_opponent_1 = fill_to_edge<dir_1>(~opponent);
+	const BitBoard fixed_opponent_2 = fill_to_edge<dir_2>(~opponent);
+
+	self_fixed &= (~(fixed_1 | fixed_2)) | (~(fixed_self_1 & fixed_self_2));
+	opponent_fixed &= (~(fixed_1 | fixed_2)) | (~(fixed_opponent_1 & fixed_opponent_2));
+}
 
-	const BitBoard flipped = current.get_opponent() ^ prev.get_self();
+// The fixed stones the weights of DLAlphaBetaAI were trained on: along each line, the line is full
+// or the stones of the same colour reach an edge. The latter can still be flipped, so this is not
+// the sound set of calculate_fixed_stones(), which the searches use; the features keep it until
+// the weights are trained again.
+void legacy_fixed_stones(const BitBoard& self, const BitBoard& opponent, BitBoard& self_fixed, BitBoard& opponent_fixed) {
+	BitBoard empty = ~(self | opponent);
+	self_fixed = self;
+	opponent_fixed = opponent;
+
+	//Fixed for LR
+	legacy_fixed_stones_helper<LEFT, RIGHT>(self, opponent, empty, self_fixed, opponent_fixed);
+
+	//Fixed for UD
+	legacy_fixed_stones_helper<UP, DOWN>(self, opponent, empty, self_fixed, opponent_fixed);
+
+	//Fixed for UL-DR
+	legacy_fixed_stones_helper<UP_LEFT, DOWN_RIGHT>(self, opponent, empty, self_fixed, opponent_fixed);
+
+	//Fixed for UR-DL
+	legacy_fixed_stones_helper<UP_RIGHT, DOWN_LEFT>(self, opponent, empty, self_fixed, opponent_fixed);
+}
+
+// `current_*` describe the position to evaluate from the side to move, `prev_candidates` are the
+// candidates of the previous position and `flipped` the stones changed by the last move.
+std::vector<double> get_feature_params(const BitBoard& current_self, const BitBoard& current_opponent, const BitBoard& current_candidates,
+	const BitBoard& prev_candidates, const BitBoard& flipped, const bool is_myturn) {
+
+	const BitBoard& my_board = is_myturn ? current_self : current_opponent;
+	const BitBoard& opponent_board = is_myturn ? current_opponent : current_self;
+
+	const BitBoard empty = ~(my_board | opponent_board);
+
+	const BitBoard& my_candidates = is_myturn ? current_candidates : prev_candidates;
+	const BitBoard& opponent_candidates = is_myturn ? prev_candidates : current_candidates;
 
 	BitBoard my_fixed = 0x0LL, opponent_fixed = 0x0LL;
-	calculate_fixed_stones(my_board, opponent_board, my_fixed, opponent_fixed);
+	legacy_fixed_stones(my_board, opponent_board, my_fixed, opponent_fixed);
 
 	const int num_my_fixed = count_stones(my_fixed);
 	const int num_opponent_fixed = count_stones(opponent_fixed);
@@ -98,7 +146,7 @@ std::vector<double> get_feature_params(const Board& current, const Board& prev,
 
 	std::vector<double> features;
 	if (num_my_fixed > BOARD_AREA / 2 || num_opponent_fixed > BOARD_AREA / 2 ||
-		((is_myturn ? num_my_candidates : num_opponent_candidates) == 0 && count_stones(current.pass().get_candidates()) == 0)) {
+		((is_myturn ? num_my_candidates : num_opponent_candidates) == 0 && is_empty(move_kernel.candidates(current_opponent, current_self)))) {
 		features.push_back(count_stones(my_board));
 		features.push_back(count_stones(opponent_board));
 		features.push_back(num_my_candidates);
@@ -267,6 +315,16 @@ std::vector<double> get_feature_params(const Board& current, const Board& prev,
 	return features;
 }
 
+std::vector<double> get_feature_params(const Board& current, const Board& prev, const bool is_myturn) {
+	return get_feature_params(current.get_self(), current.get_opponent(), current.get_candidates(),
+		prev.get_candidates(), current.get_opponent() ^ prev.get_self(), is_myturn);
+}
+
+std::vector<double> get_feature_params(SearchBoard& current, const bool is_myturn) {
+	return get_feature_params(current.get_self(), current.get_opponent(), current.get_candidates(),
+		current.get_prev_candidates(), current.get_last_played(), is_myturn);
+}
+
 inline double result_evaluation(const int my_stones, const int opponent_stones) {
 	return 2.0 * (double)(my_stones * my_stones + (BOARD_AREA - opponent_stones - my_stones)) / (double)(BOARD_AREA * BOARD_AREA) - 1.0;
 }
\ No newline at end of file
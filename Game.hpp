@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <algorithm>
 #include "Board.hpp"
 #include "AI.hpp"
 
@@ -15,6 +16,8 @@ private:
 	std::unique_ptr<AI> white_ai = nullptr;
 	std::function<Cell(const Board&)> human_play;
 	Cell move = Cell::Pass();
+	// the AI which has just moved thinks on the opponent's time
+	bool pondering = false;
 public:
 	Game() : board(Board(init_black, init_white)) {};
 
@@ -43,6 +46,10 @@ public:
 		human_play = human_play_;
 	}
 
+	void set_pondering(const bool enabled) {
+		pondering = enabled;
+	}
+
 	bool is_game_over() const { return board.finished(); }
 
 	bool has_valid_move() const { return board.has_candidate(); }
@@ -63,6 +70,9 @@ public:
 			move = ai->choose_move();
 			std::cout << "evaluation: " << ai->eval() << std::endl;
 			std::cout << "time: " << ai->elapsed << " ms" << std::endl;
+			if (ai->nodes > 0) {
+				std::cout << "nodes: " << ai->nodes << " (" << (long long)(ai->nodes * 1000.0 / std::max(ai->elapsed, 1.0)) << " nodes/s)" << std::endl;
+			}
 		}
 		else {
 			move = human_play(board);
@@ -71,10 +81,12 @@ public:
 	}
 
 	void play(const BitBoard& move) {
+		AI* mover = current_AI();
 		if (black_ai != nullptr) black_ai->play(move);
 		if (white_ai != nullptr) white_ai->play(move);
 		board = board.play(move);
 		current_player = opponent(current_player);
+		if (pondering && mover != nullptr) mover->ponder();
 	}
 
 	void play(const Cell& move) {
@@ -86,11 +98,13 @@ public:
 	}
 
 	void pass() {
+		AI* mover = current_AI();
 		if (black_ai != nullptr) black_ai->pass();
 		if (white_ai != nullptr) white_ai->pass();
 		board = board.pass();
 		move = Cell::Pass();
 		current_player = opponent(current_player);
+		if (pondering && mover != nullptr) mover->ponder();
 	}
 
 	std::string to_string() const {
@@ -120,6 +134,9 @@ public:
 	}
 
 	void play_on_console(std::unique_ptr<AI> black_ai_, std::unique_ptr<AI> white_ai_) {
+		std::cout << "move kernel: " << move_kernel.name << std::endl;
+		std::cout << std::endl;
+
 		std::string black_y_or_n;
 		while (black_y_or_n != "y" && black_y_or_n != "n") {
 			std::cout << "Do you use AI for black player? (y / n) : ";
@@ -142,6 +159,8 @@ public:
 		if (white_y_or_n == "y") {
 			set_white_AI(std::move(white_ai_));
 		}
+		// against a human, the AI uses the time the human thinks
+		set_pondering(black_y_or_n != white_y_or_n);
 
 		auto human_play = [](const Board& board) {
 			std::string move;
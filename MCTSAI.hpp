@@ -0,0 +1,384 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+
+#include "AI.hpp"
+#include "NodeArena.hpp"
+#include "ParallelSearch.hpp"
+#include "DLAlphaBetaAI.hpp"
+
+/**
+Monte Carlo tree search
+
+Each simulation walks down the tree from the root, choosing at each node the child of the best
+score, UCT or PUCT, until a leaf. The value of the leaf is the result of a random playout to the
+end of the game, or the win rate predicted from the network of DLAlphaBetaAI, and is backed up
+along the path. A leaf is expanded once visited a few times; the move played is the most visited
+at the root.
+
+The threads of the pool run simulations in the same tree without lock. Every node on the way
+down takes a virtual loss, some visits of no value, so that the other threads prefer other
+paths until the simulation is backed up. The first thread reaching a leaf to expand claims it,
+the others evaluate it as a leaf meanwhile.
+
+The nodes come from a NodeArena emptied at each move. Once it is full, the leaves are no longer
+expanded but still evaluated.
+*/
+
+enum class TreePolicy {
+	UCT,	// mean value + C * sqrt(ln N / n)
+	PUCT	// mean value + C * prior * sqrt(N) / (1 + n), the priors from a static score of the moves
+};
+
+enum class LeafValue {
+	PLAYOUT,	// result of a random playout
+	NETWORK		// win rate predicted by the network of DLAlphaBetaAI
+};
+
+struct MCTSNode {
+	BitBoard move;		// the move leading to the node, empty for a pass
+	BitBoard flipped;
+	float prior;
+	std::atomic<int> visits;			// virtual losses of the simulations on the way included
+	std::atomic<long long> value;		// sum of the results for the player who made `move`, in VALUE_UNIT
+	std::atomic<std::uint32_t> first_child;
+	std::atomic<unsigned char> state;	// LEAF, EXPANDING or EXPANDED
+	unsigned char num_children;
+
+	static constexpr unsigned char LEAF = 0;
+	static constexpr unsigned char EXPANDING = 1;
+	static constexpr unsigned char EXPANDED = 2;
+	static constexpr long long VALUE_UNIT = 1 << 16;
+
+	void init(const BitBoard& move_, const BitBoard& flipped_, const float prior_) {
+		move = move_;
+		flipped = flipped_;
+		prior = prior_;
+		visits.store(0, std::memory_order_relaxed);
+		value.store(0, std::memory_order_relaxed);
+		first_child.store(NodeArena<MCTSNode>::NONE, std::memory_order_relaxed);
+		state.store(LEAF, std::memory_order_relaxed);
+		num_children = 0;
+	}
+
+	// The position of the node, from the one of its parent.
+	Board play(const Board& board) const {
+		return Board(board.get_opponent() ^ flipped, board.get_self() | move | flipped);
+	}
+
+	Cell get_move() const { return is_empty(move) ? Cell::Pass() : Cell(move); }
+
+	// Mean result for the player who made `move`, `otherwise` if not visited.
+	double mean(const double otherwise) const {
+		const int n = visits.load(std::memory_order_relaxed);
+		if (n <= 0) return otherwise;
+		return (double)value.load(std::memory_order_relaxed) / VALUE_UNIT / n;
+	}
+};
+
+class MCTSAI : public AI {
+private:
+	static constexpr std::uint32_t NONE = NodeArena<MCTSNode>::NONE;
+	static constexpr int MAX_PATH = 2 * BOARD_AREA;	// moves and passes to the end of a game
+
+	static constexpr int VIRTUAL_LOSS = 3;
+	static constexpr double UCT_C = 1.0;
+	static constexpr double PUCT_C = 1.5;
+	static constexpr double PRIOR_TEMPERATURE = 2.0;
+	// visits of a leaf before its children are created: a playout is noisy, the network is not
+	static constexpr int PLAYOUT_EXPAND_VISITS = 4;
+	static constexpr int NETWORK_EXPAND_VISITS = 1;
+	// discs of deviation of the win rate around the disc count predicted by the network
+	static constexpr double NETWORK_DISC_SCALE = 4.0;
+
+	TreePolicy policy;
+	LeafValue leaf_value;
+	std::unique_ptr<DLAlphaBetaAI> network;
+	NodeArena<MCTSNode> tree;
+	std::uint32_t root = NONE;
+	double evaluation = 0;
+	Cell move = Cell::Pass();
+
+	// Budget per move, 0 for none; without any, one second.
+	long long time_limit = 1000;	// milliseconds
+	long long playout_limit = 0;
+	int threads = 0;	// 0: the whole pool
+	std::chrono::steady_clock::time_point search_start;
+	std::atomic<long long> playouts{ 0 };
+	std::atomic<int> next_seed{ 0 };
+
+	struct Random {
+		std::uint64_t state;
+
+		explicit Random(const std::uint64_t seed) : state(seed * 0x9e3779b97f4a7c15ULL + 1) {};
+
+		std::uint64_t operator()() {
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			return state * 0x2545f4914f6cdd1dULL;
+		}
+	};
+
+	// A random move of `moves`, not empty.
+	static BitBoard random_move(BitBoard moves, Random& random) {
+		for (int skip = (int)(random() % count_stones(moves)); skip > 0; --skip) moves &= moves - 1;
+		return moves & (~moves + 1);
+	}
+
+	// 1 for a win of the player to move, 0.5 for a draw, 0 for a loss.
+	static double result(const BitBoard& self, const BitBoard& opponent) {
+		const int diff = count_stones(self) - count_stones(opponent);
+		return (diff > 0) ? 1.0 : (diff < 0) ? 0.0 : 0.5;
+	}
+
+	// Result of random moves from `board` to the end of the game, for the player to move.
+	static double playout(const Board& board, Random& random) {
+		BitBoard self = board.get_self(), opponent = board.get_opponent();
+		bool swapped = false;
+		bool passed = false;
+		while (true) {
+			const BitBoard moves = move_kernel.candidates(self, opponent);
+			if (is_empty(moves)) {
+				if (passed) break;
+				passed = true;
+			}
+			else {
+				passed = false;
+				const BitBoard move_ = random_move(moves, random);
+				const BitBoard flipped = move_kernel.flipped(self, opponent, move_);
+				self |= move_ | flipped;
+				opponent ^= flipped;
+			}
+			std::swap(self, opponent);
+			swapped = !swapped;
+		}
+		const double out = result(self, opponent);
+		return swapped ? 1.0 - out : out;
+	}
+
+	// Win rate of the player to move from a value of the network, a predicted result_evaluation()
+	// of the final discs, i.e. (discs^2 + empties) * 2 / BOARD_AREA^2 - 1 with no empty left.
+	static double network_win_rate(const double value) {
+		const double squared = std::max(0.0, std::min(1.0, (value + 1.0) / 2.0)) * BOARD_AREA * BOARD_AREA;
+		return 1.0 / (1.0 + std::exp(-(std::sqrt(squared) - BOARD_AREA / 2) / NETWORK_DISC_SCALE));
+	}
+
+	// Value of the leaf `board`, not finished, for the player to move.
+	double evaluate(const Board& board, Random& random) {
+		if (leaf_value == LeafValue::NETWORK) return network_win_rate(network->value(board));
+		return playout(board, random);
+	}
+
+	// Creates the children of `node` at `board`, sorted by prior. False if another thread does,
+	// or if the arena is full.
+	bool expand(MCTSNode& node, const Board& board) {
+		unsigned char expected = MCTSNode::LEAF;
+		if (!node.state.compare_exchange_strong(expected, MCTSNode::EXPANDING, std::memory_order_acquire)) return false;
+
+		const BitBoard candidates = board.get_candidates();
+		ChildBatch batch;
+		if (is_empty(candidates)) {
+			batch.size = 1;
+			batch.move[0] = batch.flipped[0] = batch.candidates[0] = 0x0LL;
+		}
+		else {
+			move_kernel.children(board.get_self(), board.get_opponent(), candidates, batch);
+		}
+
+		const std::uint32_t first = tree.allocate(batch.size);
+		if (first == NONE) {
+			node.state.store(MCTSNode::LEAF, std::memory_order_release);
+			return false;
+		}
+
+		// the static score of AlphaBetaAI: few replies and no corner for the opponent
+		const BitBoard corner = 0x8100000000000081LL;
+		double scores[ChildBatch::CAPACITY];
+		double max_score = -HUGE_VAL;
+		for (int idx = 0; idx < batch.size; ++idx) {
+			const BitBoard replies = batch.candidates[idx];
+			scores[idx] = -count_stones(replies) - 3.0 * count_stones(replies & corner) + 4.0 * count_stones(batch.move[idx] & corner);
+			max_score = std::max(max_score, scores[idx]);
+		}
+		double sum = 0;
+		for (int idx = 0; idx < batch.size; ++idx) {
+			scores[idx] = std::exp((scores[idx] - max_score) / PRIOR_TEMPERATURE);
+			sum += scores[idx];
+		}
+
+		int order[ChildBatch::CAPACITY];
+		for (int idx = 0; idx < batch.size; ++idx) order[idx] = idx;
+		std::sort(order, order + batch.size, [&](const int a, const int b) { return scores[a] > scores[b]; });
+		for (int idx = 0; idx < batch.size; ++idx) {
+			const int child = order[idx];
+			tree[first + idx].init(batch.move[child], batch.flipped[child], (float)(scores[child] / sum));
+		}
+
+		node.num_children = (unsigned char)batch.size;
+		node.first_child.store(first, std::memory_order_relaxed);
+		node.state.store(MCTSNode::EXPANDED, std::memory_order_release);
+		return true;
+	}
+
+	// The child of the best score, for the player to move at `node`.
+	std::uint32_t select(const MCTSNode& node) const {
+		const std::uint32_t first = node.first_child.load(std::memory_order_relaxed);
+		const int parent_visits = std::max(1, node.visits.load(std::memory_order_relaxed));
+		// an unvisited child is first assumed as good as the node for the player to move
+		const double first_play = 1.0 - node.mean(0.5);
+		const double log_visits = std::log((double)parent_visits);
+		const double sqrt_visits = std::sqrt((double)parent_visits);
+
+		std::uint32_t best = first;
+		double best_score = -HUGE_VAL;
+		for (std::uint32_t idx = first; idx < first + node.num_children; ++idx) {
+			const MCTSNode& child = tree[idx];
+			const int visits = child.visits.load(std::memory_order_relaxed);
+			double score;
+			if (policy == TreePolicy::UCT) {
+				// the unvisited children in the order of their priors
+				if (visits <= 0) return idx;
+				score = child.mean(0.0) + UCT_C * std::sqrt(log_visits / visits);
+			}
+			else {
+				score = child.mean(first_play) + PUCT_C * child.prior * sqrt_visits / (1 + std::max(0, visits));
+			}
+			if (score > best_score) {
+				best_score = score;
+				best = idx;
+			}
+		}
+		return best;
+	}
+
+	// One simulation from the root.
+	void simulate(Random& random) {
+		std::uint32_t path[MAX_PATH + 1];
+		int length = 0;
+		std::uint32_t index = root;
+		Board position = board;
+		const int expand_visits = (leaf_value == LeafValue::NETWORK) ? NETWORK_EXPAND_VISITS : PLAYOUT_EXPAND_VISITS;
+
+		double value;	// for the player to move at `position`
+		while (true) {
+			MCTSNode& node = tree[index];
+			path[length++] = index;
+			const int visits = node.visits.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+
+			if (node.state.load(std::memory_order_acquire) != MCTSNode::EXPANDED) {
+				if (position.finished()) {
+					value = result(position.get_self(), position.get_opponent());
+					break;
+				}
+				if (visits < expand_visits || !expand(node, position)) {
+					value = evaluate(position, random);
+					break;
+				}
+			}
+			index = select(node);
+			position = tree[index].play(position);
+		}
+
+		// the value of a node is for the player who moved to it
+		for (int idx = length - 1; idx >= 0; --idx) {
+			MCTSNode& node = tree[path[idx]];
+			value = 1.0 - value;
+			node.value.fetch_add((long long)(value * MCTSNode::VALUE_UNIT), std::memory_order_relaxed);
+			node.visits.fetch_add(1 - VIRTUAL_LOSS, std::memory_order_relaxed);
+		}
+	}
+
+	bool out_of_budget() const {
+		if (playout_limit > 0 && playouts.load(std::memory_order_relaxed) >= playout_limit) return true;
+		return (time_limit > 0 || playout_limit <= 0) && search_time() >= ((time_limit > 0) ? time_limit : 1000);
+	}
+
+	long long search_time() const {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - search_start).count();
+	}
+
+	// Simulations of one thread until the budget runs out.
+	void search() {
+		Random random((std::uint64_t)next_seed.fetch_add(1) + 1);
+		while (!out_of_budget()) {
+			simulate(random);
+			playouts.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+public:
+	// `tree_mb`: size of the arena of the tree. The network is read from the file of DLAlphaBetaAI.
+	MCTSAI(const TreePolicy policy_ = TreePolicy::PUCT, const LeafValue leaf_value_ = LeafValue::PLAYOUT, const size_t tree_mb = 256)
+		: AI(), policy(policy_), leaf_value(leaf_value_), tree(tree_mb) {
+		if (leaf_value == LeafValue::NETWORK) network = std::make_unique<DLAlphaBetaAI>(0.0, 0);
+	}
+
+	double eval() const override {
+		return evaluation;
+	}
+
+	// Simulations within `milliseconds` per move, 0 for no time limit.
+	void set_time_limit(const long long milliseconds) {
+		time_limit = milliseconds;
+	}
+
+	// At most `playouts_` simulations per move, 0 for no limit.
+	void set_playout_limit(const long long playouts_) {
+		playout_limit = playouts_;
+	}
+
+	// Threads of the pool running simulations, 0 for all of them.
+	void set_threads(const int threads_) {
+		threads = threads_;
+	}
+
+	// Simulations per second of the last move.
+	double playout_rate() const {
+		return nodes * 1000.0 / std::max(elapsed, 1.0);
+	}
+
+	// The evaluation is the win rate of the move played, from 0 to 1.
+	Cell choose_move() override {
+		std::chrono::system_clock::time_point start, end;
+		start = std::chrono::system_clock::now();
+
+		tree.clear();
+		root = tree.allocate(1);
+		tree[root].init(0x0LL, 0x0LL, 1.0f);
+		playouts = 0;
+		search_start = std::chrono::steady_clock::now();
+
+		move = Cell::Pass();
+		evaluation = 0.5;
+		if (board.has_candidate()) {
+			expand(tree[root], board);
+
+			TaskGroup group;
+			const int workers = (threads > 0) ? std::min(threads, group.pool_size()) : group.pool_size();
+			for (int id = 1; id < workers; ++id) group.run([this] { search(); });
+			search();
+			group.wait();
+
+			const MCTSNode& node = tree[root];
+			const std::uint32_t first = node.first_child.load(std::memory_order_relaxed);
+			std::uint32_t best = first;
+			for (std::uint32_t idx = first; idx < first + node.num_children; ++idx) {
+				if (tree[idx].visits.load(std::memory_order_relaxed) > tree[best].visits.load(std::memory_order_relaxed)) best = idx;
+			}
+			move = tree[best].get_move();
+			evaluation = tree[best].mean(0.5);
+		}
+
+		end = std::chrono::system_clock::now();
+		elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		nodes = playouts;
+
+		return move;
+	}
+};
@@ -3,112 +3,25 @@
 #include <thread>
 #include <mutex>
 #include <algorithm>
+#include <cstdint>
 
 #include "AI.hpp"
+#include "ParallelSearch.hpp"
+#include "NodeArena.hpp"
 
-class Node {
-private:
-	int evaluation = 0;
-	Cell prev_move;
-	bool is_evaluated = false;
-	Board board;
-	std::vector<std::shared_ptr<Node>> children;
-
-	static int nearby_empty(const BitBoard& stones, const BitBoard& empty) {
-		BitBoard near = 0x0LL;
-
-		for (auto& dir : ALL_DIRS) {
-			near |= translate(stones, dir) & empty;
-		}
-
-		return count_stones(near);
-	}
+/**
+Alpha-beta search keeping its tree from one move to the next
 
-	static int evaluate_child(const Board& board, const Board& prev, const bool is_myturn) {
-		const BitBoard& self_board = is_myturn ? board.get_self() : board.get_opponent();
-		const BitBoard& opponent_board = is_myturn ? board.get_opponent() : board.get_self();
-
-		const BitBoard empty = ~(self_board | opponent_board);
-
-		const BitBoard& self_candidates = is_myturn ? board.get_candidates() : prev.get_candidates();
-		const BitBoard& opponent_candidates = is_myturn ? prev.get_candidates() : board.get_candidates();
-
-		const BitBoard diff = board.get_opponent() ^ prev.get_self();
-
-		const int n_diff_open = nearby_empty(diff, empty);
-
-		const BitBoard corner = 0x8100000000000081LL;
-
-		const int num_cand = count_stones(opponent_candidates);
-		const int num_cornoer = count_stones(opponent_candidates & corner);
-
-		const int open = is_myturn ? n_diff_open : -n_diff_open;
-
-		return -num_cand - 3 * num_cornoer + 4 * open;
-	}
-
-	void add_child(const Board& board, const Board& prev, const Cell& move, const bool is_myturn) {
-		auto child_ptr = std::make_shared<Node>(board);
-		child_ptr->prev_move = move;
-		child_ptr->evaluation = evaluate_child(board, prev, is_myturn);
-		children.push_back(std::move(child_ptr));
-	}
-
-public:
-	Node() = default;
-
-	Node(const Board& board_) : board(board_) {};
-
-	void sort_children() {
-		std::sort(children.begin(), children.end(),
-			[](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
-				return a->evaluation > b->evaluation;
-			});
-	}
-
-	~Node() = default;
-
-	bool is_leaf() const {
-		return children.empty();
-	}
-
-	int get_eval() const { return evaluation; }
-
-	void set_eval(const int& eval) {
-		evaluation = eval;
-		is_evaluated = true;
-	}
-
-	bool evaluated() const { return is_evaluated;  }
-
-	const Board& get_board() const { return board; }
-
-	Cell get_prev_move() const { return prev_move; }
-
-	const std::vector<std::shared_ptr<Node>>& get_children() const { return children; }
-
-	void create_children(const bool is_myturn) {
-		std::vector<Cell> candidates = board.get_candidate_list();
-		if (candidates.empty()) {
-			add_child(board.pass(), board, Cell::Pass(), !is_myturn);
-			return;
-		}
-		for (auto& cell : candidates) {
-			add_child(board.play(cell), board, cell, !is_myturn);
-		}
-	}
+The tree keeps the values found at each node, which order the moves of the next searches, and is
+carried over to the child played. Its nodes live in a NodeArena of a fixed size: a node only holds
+the move leading to it and the stones it flipped, 32 bytes, the positions being replayed from the
+root on the way down. Once the arena is full the search goes on without storing the new nodes.
 
-	std::shared_ptr<Node> play(const Cell& move) {
-		for (auto& child : children) {
-			if (child->prev_move == move) {
-				return child;
-			}
-		}
-		auto next = std::make_shared<Node>(board.play(move));
-		next->prev_move = move;
-		return next;
-	}
-};
+Before each search the nodes out of the tree of the root are dropped, and if the tree still fills
+more than half of the arena, the subtrees least likely to be searched again are evicted: those
+whose nodes have the most depth spent from the root, the sum of the reductions of the moves on the
+way, i.e. the deepest and latest in move order.
+*/
 
 class MemorizedAlphaBetaAI : public AI {
 private:
@@ -116,27 +29,28 @@ private:
 	int evaluation;
 	std::mutex mtx;
 	Cell move;
-	int cnt = 0;
-	std::shared_ptr<Node> root;
+	std::atomic<int> cnt{ 0 };
+	NodeArena<TreeNode> tree;
+	std::uint32_t root;
 
-	static int nearby_empty(const BitBoard& stones, const BitBoard& empty) {
-		BitBoard near = 0x0LL;
+	static constexpr std::uint32_t NONE = NodeArena<TreeNode>::NONE;
 
-		for (auto& dir : ALL_DIRS) {
-			near |= translate(stones, dir) & empty;
-		}
+	// bins of the spent depth per ply, for the eviction
+	static constexpr int SPENT_BINS_PER_PLY = 10;
+	static constexpr int MAX_SPENT_BIN = 64 * SPENT_BINS_PER_PLY;
 
-		return count_stones(near);
+	static int nearby_empty(const BitBoard& stones, const BitBoard& empty) {
+		return count_stones(neighbours(stones) & empty);
 	}
 
-	static int evaluate_child(const Board& board, const Board& prev, const bool is_myturn) {
+	static int evaluate_child(const Board& board, const BitBoard& candidates, const Board& prev, const BitBoard& prev_candidates, const bool is_myturn) {
 		const BitBoard& self_board = is_myturn ? board.get_self() : board.get_opponent();
 		const BitBoard& opponent_board = is_myturn ? board.get_opponent() : board.get_self();
 
 		const BitBoard empty = ~(self_board | opponent_board);
 
-		const BitBoard& self_candidates = is_myturn ? board.get_candidates() : prev.get_candidates();
-		const BitBoard& opponent_candidates = is_myturn ? prev.get_candidates() : board.get_candidates();
+		const BitBoard& self_candidates = is_myturn ? candidates : prev_candidates;
+		const BitBoard& opponent_candidates = is_myturn ? prev_candidates : candidates;
 
 		const BitBoard diff = board.get_opponent() ^ prev.get_self();
 
@@ -152,24 +66,46 @@ private:
 		return -num_cand - 3 * num_cornoer + 4 * open;
 	}
 
-	static std::vector<Board> sorted_children(const Board& board, const bool is_myturn) {
-		auto candidates = board.get_candidate_list();
+	// Creates the children of `board` into `children`, scored by evaluate_child(), and returns their
+	// number. `is_myturn` is the side of `board`.
+	static int create_children(const Board& board, const bool is_myturn, TreeNode* children) {
+		const BitBoard candidates = board.get_candidates();
+		if (is_empty(candidates)) {
+			const Board next = board.pass();
+			children[0] = TreeNode::leaf(0x0LL, 0x0LL, evaluate_child(next, next.get_candidates(), board, candidates, !is_myturn));
+			return 1;
+		}
 
-		if (candidates.empty()) {
-			return std::vector<Board>({ board.pass() });
+		ChildBatch batch;
+		move_kernel.children(board.get_self(), board.get_opponent(), candidates, batch);
+		for (int idx = 0; idx < batch.size; ++idx) {
+			const BitBoard flipped = batch.flipped[idx];
+			const Board next(board.get_opponent() ^ flipped, board.get_self() | batch.move[idx] | flipped);
+			children[idx] = TreeNode::leaf(batch.move[idx], flipped, evaluate_child(next, batch.candidates[idx], board, candidates, !is_myturn));
 		}
-		else {
-			std::vector<Board> children(candidates.size());
-			size_t idx = 0;
-			for (auto& cell : candidates) {
-				children[idx++] = board.play(cell);
-			}
-			std::sort(children.begin(), children.end(),
-				[board, is_myturn](const Board& a, const Board& b) {
-					return evaluate_child(a, board, !is_myturn) > evaluate_child(b, board, !is_myturn);
-				});
-			return children;
+		return batch.size;
+	}
+
+	// The children of `node`, created on the first visit: in the arena if `stored` and there is
+	// room, else in `local`, to be created again on the next visit.
+	TreeNode* children_of(TreeNode& node, const Board& board, const bool is_myturn, const bool stored, TreeNode* local, int& size) {
+		if (node.first_child != NONE) {
+			size = node.num_children;
+			return &tree[node.first_child];
 		}
+		size = create_children(board, is_myturn, local);
+		const std::uint32_t first = stored ? tree.allocate(size) : NONE;
+		if (first == NONE) return local;
+		std::copy(local, local + size, &tree[first]);
+		node.first_child = first;
+		node.num_children = (unsigned char)size;
+		return &tree[first];
+	}
+
+	static void sort_children(TreeNode* children, const int size) {
+		std::sort(children, children + size, [](const TreeNode& a, const TreeNode& b) {
+			return a.evaluation > b.evaluation;
+		});
 	}
 
 	static int evaluate(const Board& board, const Board& prev, const bool is_myturn) {
@@ -242,155 +178,192 @@ private:
 		return score;
 	}
 
-	void alpha_beta(const std::shared_ptr<Node>& board_ptr, const Board& prev, const double depth, const bool is_myturn, int alpha, int beta) {
-		auto& board = board_ptr->get_board();
+	// `board`: the position of `node`, `prev` the one of its parent. `stored`: the node is in the
+	// arena, so that its children may be. `split`: the closest split point above the node, if any.
+	// Evaluations set below a cut off split point are not exact, but only ever used for move ordering.
+	void alpha_beta(TreeNode& node, const Board& board, const Board& prev, const double depth, const bool is_myturn, int alpha, int beta,
+		const SplitPoint* split, const bool stored) {
 		cnt++;
+		if (cut_off(split)) return;
 		if (depth <= 0 || board.finished()) {
-			if (!board_ptr->evaluated()) board_ptr->set_eval(evaluate(board, prev, is_myturn));
+			if (!node.evaluated) node.set_eval(evaluate(board, prev, is_myturn));
 			return;
 		}
 
-		if (board_ptr->get_children().empty()) board_ptr->create_children(is_myturn);
-		
-		board_ptr->sort_children();
-		auto children = board_ptr->get_children();
-
-		if (is_myturn) {
-			if (children.size() == 1) {
-				alpha_beta(children.at(0), board, depth, !is_myturn, alpha, beta);
-				board_ptr->set_eval(std::max(alpha, children.at(0)->get_eval()));
-			}
-
-			int idx = 0;
-			for (auto& child : children) {
-				if (idx < 2) {
-					alpha_beta(child, board, depth - 0.7, !is_myturn, alpha, beta);
-				}
-				else if (idx < 5) {
-					alpha_beta(child, board, depth - 1.0, !is_myturn, alpha, beta);
-				}
-				else if (idx < 8) {
-					alpha_beta(child, board, depth - 1.7, !is_myturn, alpha, beta);
-				}
-				else if (idx < 10) {
-					alpha_beta(child, board, depth - 2.3, !is_myturn, alpha, beta);
-				}
-				else {
-					alpha_beta(child, board, depth - 3.0, !is_myturn, alpha, beta);
-				}
-				alpha = std::max(alpha, child->get_eval());
-				idx++;
-				if (alpha >= beta) break;
+		TreeNode local[ChildBatch::CAPACITY];
+		int size = 0;
+		TreeNode* const block = children_of(node, board, is_myturn, stored, local, size);
+		const bool children_stored = block != local;
+		sort_children(block, size);
+
+		// best first for the player to move
+		TreeNode* children[ChildBatch::CAPACITY];
+		for (int idx = 0; idx < size; ++idx) children[idx] = &block[is_myturn ? idx : size - 1 - idx];
+
+		for (int idx = 0; idx < size; ++idx) {
+			if (should_split(idx, depth)) {
+				split_children(split, idx, size, alpha, beta,
+					[&](const int child_idx, const int child_alpha, const int child_beta, const SplitPoint* child_split) {
+						TreeNode& child = *children[child_idx];
+						alpha_beta(child, child.play(board), board, depth - child_reduction(child_idx), !is_myturn, child_alpha, child_beta, child_split, children_stored);
+						return child.evaluation;
+					},
+					[&](const int, const int value) {
+						if (is_myturn) alpha = std::max(alpha, value);
+						else beta = std::min(beta, value);
+						return alpha >= beta;
+					});
+				break;
 			}
-			board_ptr->set_eval(alpha);
+			TreeNode& child = *children[idx];
+			alpha_beta(child, child.play(board), board, (size == 1) ? depth : depth - child_reduction(idx), !is_myturn, alpha, beta, split, children_stored);
+			if (is_myturn) alpha = std::max(alpha, child.evaluation);
+			else beta = std::min(beta, child.evaluation);
+			if (alpha >= beta) break;
 		}
-		else {
-			if (children.size() == 1) {
-				alpha_beta(children.at(0), board, depth, !is_myturn, alpha, beta);
-				board_ptr->set_eval(std::min(beta, children.at(0)->get_eval()));
-			}
-			std::reverse(children.begin(), children.end());
-			int idx = 0;
-			for (auto& child : children) {
-				if (idx < 2) {
-					alpha_beta(child, board, depth - 0.7, !is_myturn, alpha, beta);
-				}
-				else if (idx < 5) {
-					alpha_beta(child, board, depth - 1.0, !is_myturn, alpha, beta);
-				}
-				else if (idx < 8) {
-					alpha_beta(child, board, depth - 1.7, !is_myturn, alpha, beta);
-				}
-				else if (idx < 10) {
-					alpha_beta(child, board, depth - 2.3, !is_myturn, alpha, beta);
-				}
-				else {
-					alpha_beta(child, board, depth - 3.0, !is_myturn, alpha, beta);
-				}
-				beta = std::min(beta, child->get_eval());
-				idx++;
-				if (alpha >= beta) break;
+		node.set_eval(is_myturn ? alpha : beta);
+	}
+
+	// Calls `visit(node, spent, is_myturn)` on each node of the tree with children, depth first,
+	// `spent` being its bin of spent depth. Its children are visited if it returns true.
+	template <class Visit>
+	void walk_tree(Visit visit) {
+		struct Entry {
+			std::uint32_t index;
+			double spent;
+			bool is_myturn;
+		};
+		std::vector<Entry> stack = { { root, 0.0, true } };
+		while (!stack.empty()) {
+			const Entry entry = stack.back();
+			stack.pop_back();
+			TreeNode& node = tree[entry.index];
+			if (node.first_child == NONE) continue;
+			if (!visit(node, std::min((int)(entry.spent * SPENT_BINS_PER_PLY), (int)MAX_SPENT_BIN), entry.is_myturn)) continue;
+
+			const int size = node.num_children;
+			for (int pos = 0; pos < size; ++pos) {
+				// the children of the opponent's nodes are searched from the last
+				const int idx = entry.is_myturn ? pos : size - 1 - pos;
+				const double spent = entry.spent + ((size == 1) ? 0.0 : child_reduction(idx));
+				stack.push_back({ node.first_child + pos, spent, !entry.is_myturn });
 			}
-			board_ptr->set_eval(beta);
 		}
+	}
+
+	// Unlinks the children of the nodes with the most depth spent, so that at most `target` nodes
+	// stay in the tree. The spent depth only grows on the way down, so what stays is a tree.
+	void evict(const std::uint32_t target) {
+		// children of the nodes of each bin
+		std::vector<std::uint32_t> counts(MAX_SPENT_BIN + 1, 0);
+		walk_tree([&](const TreeNode& node, const int bin, const bool) {
+			counts[bin] += node.num_children;
+			return true;
+		});
+
+		int last_bin = -1;
+		std::uint32_t kept = 1;
+		while (last_bin < MAX_SPENT_BIN && kept + counts[last_bin + 1] <= target) kept += counts[++last_bin];
+
+		walk_tree([&](TreeNode& node, const int bin, const bool) {
+			if (bin <= last_bin) return true;
+			node.first_child = NONE;
+			node.num_children = 0;
+			return false;
+		});
+	}
 
+	// Drops the nodes out of the tree of the root, and evicts subtrees if it fills more than half
+	// of the arena, the other half being left to the search.
+	void make_room() {
+		root = tree.compact(root);
+		if (tree.used() <= tree.capacity() / 2) return;
+		evict(tree.capacity() / 2);
+		root = tree.compact(root);
+	}
+
+	// A new tree of the root only.
+	void reset_tree() {
+		tree.clear();
+		root = tree.allocate(1);
+		tree[root] = TreeNode::leaf(0x0LL, 0x0LL, 0);
+	}
+
+	// Moves the root to its child `played`, empty for a pass; the other subtrees are dropped before
+	// the next search.
+	void reroot(const BitBoard& played) {
+		const std::uint32_t child = find_child(tree, root, played);
+		if (child == NONE) reset_tree();
+		else root = child;
 	}
 
 public:
-	MemorizedAlphaBetaAI(const double depth_ = 8.0) : AI(), depth(depth_) {};
+	// `tree_mb`: size of the arena of the tree.
+	MemorizedAlphaBetaAI(const double depth_ = 8.0, const size_t tree_mb = 256) : AI(), depth(depth_), tree(tree_mb) {
+		reset_tree();
+	}
 
 	double eval() const override {
 		return evaluation;
 	}
 
-	void worker(const std::shared_ptr<Node>& child, const Board& board, const double depth)
+	void worker(TreeNode& child, const double depth, const bool stored)
 	{
-		alpha_beta(child, board, depth, false, evaluation, INT_MAX - 1);
+		int alpha;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			alpha = evaluation;
+		}
+
+		alpha_beta(child, child.play(board), board, depth, false, alpha, INT_MAX - 1, nullptr, stored);
 
+		// a move failing low ties with alpha, so only a strictly better one replaces the best
 		std::lock_guard<std::mutex> lock(mtx);
-		//if (evaluation < tmp) {
-		//	evaluation = tmp;
-		//	move = Cell((child.get_opponent() | child.get_self()) ^ (board.get_opponent() | board.get_self()));
-		//}
+		if (evaluation < child.evaluation) {
+			evaluation = child.evaluation;
+			move = child.get_move();
+		}
 	}
 
 	Cell choose_move() override {
 		std::chrono::system_clock::time_point start, end;
 		start = std::chrono::system_clock::now();
 
-		if (root->get_children().empty()) {
-			root->create_children(true);
-		}
-		root->sort_children();
+		make_room();
+		TreeNode local[ChildBatch::CAPACITY];
+		int size = 0;
+		TreeNode* const children = children_of(tree[root], board, true, true, local, size);
+		const bool stored = children != local;
+		sort_children(children, size);
 
 		const int rest_turn = count_stones(~(board.get_opponent() | board.get_self()));
 
-		std::vector<std::thread> threads;
-
 		evaluation = INT_MIN + 1;
 		cnt = 0;
 
-		if (rest_turn < 13) {
-			int cnt = 0;
-			for (auto& child : root->get_children()) {
-				if (cnt < 2) {
-					threads.push_back(std::thread(&MemorizedAlphaBetaAI::worker, this, child, board, depth + 3.5));
-				}
-				else if (cnt < 6) {
-					threads.push_back(std::thread(&MemorizedAlphaBetaAI::worker, this, child, board, depth + 2.0));
-				}
-				else {
-					threads.push_back(std::thread(&MemorizedAlphaBetaAI::worker, this, child, board, depth));
-				}
-				cnt++;
+		// the first move alone, then the others in parallel with its value as alpha
+		TaskGroup group;
+		for (int idx = 0; idx < size; ++idx) {
+			double child_depth = depth - 0.5;
+			if (rest_turn < 13) {
+				child_depth = depth;
+				if (idx < 2) child_depth = depth + 3.5;
+				else if (idx < 6) child_depth = depth + 2.0;
 			}
-		}
-		else {
-			int cnt = 0;
-			for (auto& child : root->get_children()) {
-				if (cnt < 2) {
-					threads.push_back(std::thread(&MemorizedAlphaBetaAI::worker, this, child, board, depth + 0.5));
-				}
-				else if (cnt < 6) {
-					threads.push_back(std::thread(&MemorizedAlphaBetaAI::worker, this, child, board, depth));
-				}
-				else {
-					threads.push_back(std::thread(&MemorizedAlphaBetaAI::worker, this, child, board, depth - 0.5));
-				}
-				cnt++;
+			else {
+				if (idx < 2) child_depth = depth + 0.5;
+				else if (idx < 6) child_depth = depth;
 			}
-		}
 
-		for (auto& thd : threads)
-		{
-			thd.join();
+			TreeNode& child = children[idx];
+			if (idx == 0) worker(child, child_depth, stored);
+			else group.run([this, &child, child_depth, stored] { worker(child, child_depth, stored); });
 		}
+		group.wait();
+
 		std::cout << "count: " << cnt << std::endl;
 
-		root->sort_children();
-		auto& front = root->get_children().at(0);
-		move = front->get_prev_move();
-		evaluation = front->get_eval();
+		sort_children(children, size);
 
 		end = std::chrono::system_clock::now();
 		elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -398,28 +371,28 @@ public:
 		return move;
 	}
 
-	void load_board(const Board& board_) {
+	void load_board(const Board& board_) override {
 		AI::load_board(board_);
-		root = std::make_shared<Node>(board);
+		reset_tree();
 	}
 
-	void play(const Cell& move) {
-		AI::play(move);
-		if (root->get_children().empty()) {
-			root = std::make_shared<Node>(board);
-		}
-		else {
-			root = root->play(move);
-		}
+	void play(const Cell& move_) override {
+		AI::play(move_);
+		reroot(move_.is_pass() ? 0x0LL : from_cell(move_));
 	}
 
-	void pass() {
+	void pass() override {
 		AI::pass();
-		if (root->get_children().empty()) {
-			root = std::make_shared<Node>(board);
-		}
-		else {
-			root = root->play(Cell::Pass());
-		}
+		reroot(0x0LL);
+	}
+
+	void clear() override {
+		AI::clear();
+		reset_tree();
 	}
-};
\ No newline at end of file
+
+	// Nodes of the tree and of the garbage not yet dropped, and their memory.
+	std::uint32_t tree_nodes() const { return tree.used(); }
+
+	size_t tree_bytes() const { return tree.bytes_used(); }
+};
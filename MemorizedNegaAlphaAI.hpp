@@ -2,215 +2,230 @@
 
 #include <memory>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
 
 #include "AI.hpp"
+#include "NodeArena.hpp"
+#include "ParallelSearch.hpp"
+
+/**
+Negamax search keeping its tree from one move to the next
+
+The nodes live in a NodeArena, 32 bytes each, the positions being replayed from the root. Playing a
+move moves the root to the child played, in constant time: the subtrees of the other moves are
+left in the arena, and a sweep run in the background compacts the arena to the tree of the new
+root, reclaiming them all at once. The next call needing the tree waits for the sweep, which has
+usually long finished by then. Once the arena is full the search goes on without storing the new
+nodes.
+*/
+
+// The tree of a MemorizedNegaAlphaAI, reported after each move.
+struct TreeStats {
+	std::uint32_t nodes = 0;	// in the arena, including the garbage not yet swept
+	size_t bytes = 0;
+	double reroot_us = 0;		// last re-root, on the game thread, waiting for the sweep included
+	double sweep_wait_us = 0;	// of which waiting for the previous sweep
+	double sweep_ms = 0;		// last sweep, in the background
+};
 
-class Node {
+class MemorizedNegaAlphaAI : public AI {
 private:
-	bool is_evaluated = false;
-	int evaluation = 0;
-	Cell prev_move;
-	Node* parent = nullptr;
-	Board board;
-	std::vector<std::shared_ptr<Node>> children;
-public:
-	Node() = default;
-
-	Node(const Board& board_) : board(board_) {};
-
-	void add_child(const Board& child, const Cell& move) {
-		auto child_ptr = std::make_shared<Node>(child);
-		child_ptr->parent = this;
-		child_ptr->prev_move = move;
-		children.push_back(std::move(child_ptr));
-	}
-
-	void remove_children(const int idx) {
-		children.resize(idx);
-	}
-
-	void sort_children() {
-		std::sort(children.begin(), children.end(),
-			[](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
-				if (a->is_evaluated != b->is_evaluated) {
-					if (a->is_evaluated) return a->evaluation > 0;
-					else return b->evaluation <= 0;
-				}
-
-				if (!a->is_evaluated) return a.get() < b.get();
-
-				if (a->evaluation != b->evaluation) return a->evaluation > b->evaluation;
-
-				return a.get() < b.get();
-			});
-	}
+	double depth = 0;
+	NodeArena<TreeNode> tree;
+	std::uint32_t root;
+	int cnt = 0;
+	double evaluation = 0;
+	TreeStats stats;
+	// last, so that it is joined before the rest is destroyed
+	WorkerThread sweeper;
+
+	static constexpr std::uint32_t NONE = NodeArena<TreeNode>::NONE;
+
+	// Children searched by value, best first, those not searched yet between the winning ones and
+	// the others; ties in the order of generation.
+	static bool searched_before(const TreeNode& a, const TreeNode& b) {
+		if (a.evaluated != b.evaluated) {
+			if (a.evaluated) return a.evaluation > 0;
+			else return b.evaluation <= 0;
+		}
 
-	~Node() = default;
+		if (!a.evaluated) return false;
 
-	bool is_leaf() const {
-		return children.empty();
+		return a.evaluation > b.evaluation;
 	}
 
-	int get_eval() const { return evaluation; }
-
-	void set_eval(const int& eval) {
-		evaluation = eval;
-		is_evaluated = true;
+	static void sort_children(TreeNode* children, const int size) {
+		std::stable_sort(children, children + size, searched_before);
 	}
 
-	Board get_board() const { return board; }
-
-	Node* get_parent() const { return parent; }
-
-	Cell get_prev_move() const { return prev_move; }
-
-	bool evaluated() const { return is_evaluated;  }
-
-	const std::vector<std::shared_ptr<Node>>& get_children() const { return children; }
-
-	void create_children() {
-		std::vector<Cell> candidates = board.get_candidate_list();
-		if (candidates.empty()) {
-			add_child(board.pass(), Cell::Pass());
-			return;
-		}
-		for (auto& cell : candidates) {
-			add_child(board.play(cell), cell);
+	// Creates the children of `board` into `children`, not searched, and returns their number.
+	static int create_children(const Board& board, TreeNode* children) {
+		const BitBoard candidates = board.get_candidates();
+		if (is_empty(candidates)) {
+			children[0] = TreeNode::leaf(0x0LL, 0x0LL, 0);
+			return 1;
 		}
-		std::sort(children.begin(), children.end(),
-			[](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
-				const int a_cand = count_stones(a->board.get_candidates());
-				const int b_cand = count_stones(a->board.get_candidates());
-				return a_cand < b_cand;
-			});
-	}
 
-	std::shared_ptr<Node> play(const Cell& move) {
-		for (auto& child : children) {
-			if (child->prev_move == move) {
-				return child;
-			}
+		ChildBatch batch;
+		move_kernel.children(board.get_self(), board.get_opponent(), candidates, batch);
+		for (int idx = 0; idx < batch.size; ++idx) {
+			children[idx] = TreeNode::leaf(batch.move[idx], batch.flipped[idx], 0);
 		}
-		auto next = std::make_shared<Node>(board.play(move));
-		next->parent = this;
-		next->prev_move = move;
-		return next;
+		return batch.size;
 	}
 
-	std::string to_string(int i = 0) {
-		std::string str = "";
-		str += std::to_string(i);
-		str += ' ';
-		if (is_evaluated) {
-			str += std::to_string(evaluation);
+	// The children of `node`, created on the first visit: in the arena if `stored` and there is
+	// room, else in `local`, to be created again on the next visit.
+	TreeNode* children_of(TreeNode& node, const Board& board, const bool stored, TreeNode* local, int& size) {
+		if (node.first_child != NONE) {
+			size = node.num_children;
+			return &tree[node.first_child];
 		}
-		else {
-			str += "NaN";
-		}
-		str += " ";
-		str += prev_move.to_string();
-		str += '\n';
-		for (auto& child : children) {
-			str += child->to_string(i + 1);
-		}
-		return str;
+		size = create_children(board, local);
+		const std::uint32_t first = stored ? tree.allocate(size) : NONE;
+		if (first == NONE) return local;
+		std::copy(local, local + size, &tree[first]);
+		node.first_child = first;
+		node.num_children = (unsigned char)size;
+		return &tree[first];
 	}
-};
-
-#include <cmath>
-#include <thread>
-#include <mutex>
-
-class MemorizedNegaAlphaAI : public AI {
-private:
-	double depth = 0;
-	std::shared_ptr<Node> root;
-	int cnt = 0;
-
 
-	void alpha_beta(Node& node, const double depth_, int alpha, int beta) {
+	// `board`: the position of `node`, `prev` the one of its parent. `stored`: the node is in the
+	// arena, so that its children may be.
+	void alpha_beta(TreeNode& node, const Board& board, const Board& prev, const double depth_, int alpha, int beta, const bool stored) {
 		cnt++;
 		if (depth_ <= 0) {
-			node.set_eval(-eval_leaf(node));
+			node.set_eval(-eval_leaf(board, prev));
 			return;
 		}
-		else if (node.get_board().finished()) {
-			if (!node.evaluated()) {
-				node.set_eval(-eval_leaf(node));
+		else if (board.finished()) {
+			if (!node.evaluated) {
+				node.set_eval(-eval_leaf(board, prev));
 			}
 			return;
 		}
-		else if (node.is_leaf()) {
-			node.create_children();
-		}
 
-		auto& ch = node.get_children();
+		TreeNode local[ChildBatch::CAPACITY];
+		int size = 0;
+		TreeNode* const ch = children_of(node, board, stored, local, size);
+		const bool children_stored = ch != local;
 
-		if (ch.size() == 1) {
-			auto& child = ch.at(0);
-			alpha_beta(*child, depth_ - 0.5, -beta, -alpha);
-			alpha = std::max(alpha, -child->get_eval());
+		if (size == 1) {
+			TreeNode& child = ch[0];
+			alpha_beta(child, child.play(board), board, depth_ - 0.5, -beta, -alpha, children_stored);
+			alpha = std::max(alpha, -child.evaluation);
 			node.set_eval(alpha);
 		}
-		else if(ch.size() > 6) {
-			int idx = 0;
-			for (auto& child : ch) {
-				if (child->get_eval() < 0) {
-					alpha_beta(*child, depth_ - 3, -beta, -alpha);
+		else if (size > 6) {
+			for (int idx = 0; idx < size; ++idx) {
+				TreeNode& child = ch[idx];
+				const Board next = child.play(board);
+				if (child.evaluation < 0) {
+					alpha_beta(child, next, board, depth_ - 3, -beta, -alpha, children_stored);
 				}
 				else if (idx < 4) {
-					alpha_beta(*child, depth_ - 0.7, -beta, -alpha);
+					alpha_beta(child, next, board, depth_ - 0.7, -beta, -alpha, children_stored);
 				}
 				else if (idx < 6) {
-					alpha_beta(*child, depth_ - 1, -beta, -alpha);
+					alpha_beta(child, next, board, depth_ - 1, -beta, -alpha, children_stored);
 				}
 				else if (idx < 10) {
-					alpha_beta(*child, depth_ - 2.2, -beta, -alpha);
+					alpha_beta(child, next, board, depth_ - 2.2, -beta, -alpha, children_stored);
 				}
 				else {
-					alpha_beta(*child, depth_ - 3, -beta, -alpha);
+					alpha_beta(child, next, board, depth_ - 3, -beta, -alpha, children_stored);
 				}
 
-				alpha = std::max(alpha, -child->get_eval());
-				idx++;
+				alpha = std::max(alpha, -child.evaluation);
 				if (alpha >= beta) {
 					break;
 				}
 			}
 
-			node.sort_children();
+			sort_children(ch, size);
 
 
 			node.set_eval(alpha);
 		}
 		else {
-			int idx = 0;
-			for (auto& child : ch) {
-				if (child->get_eval() < 0) {
-					alpha_beta(*child, depth_ - 2, -beta, -alpha);
+			for (int idx = 0; idx < size; ++idx) {
+				TreeNode& child = ch[idx];
+				const Board next = child.play(board);
+				if (child.evaluation < 0) {
+					alpha_beta(child, next, board, depth_ - 2, -beta, -alpha, children_stored);
 				}
 				else {
-					alpha_beta(*child, depth_ - 1, -beta, -alpha);
+					alpha_beta(child, next, board, depth_ - 1, -beta, -alpha, children_stored);
 				}
-				alpha = std::max(alpha, -child->get_eval());
-				idx++;
+				alpha = std::max(alpha, -child.evaluation);
 				if (alpha >= beta) {
 					break;
 				}
 			}
 
-			node.sort_children();
+			sort_children(ch, size);
 
 
 			node.set_eval(alpha);
 		}
 
 	}
+
+	// A new tree of the root only.
+	void reset_tree() {
+		tree.clear();
+		root = tree.allocate(1);
+		tree[root] = TreeNode::leaf(0x0LL, 0x0LL, 0);
+	}
+
+	// Moves the root to its child `played`, empty for a pass, and leaves the rest to a sweep.
+	void reroot(const BitBoard& played) {
+		const auto start = std::chrono::steady_clock::now();
+		sweeper.join();
+		stats.sweep_wait_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		const std::uint32_t child = find_child(tree, root, played);
+		if (child == NONE) reset_tree();
+		else root = child;
+		evaluation = -tree[root].evaluation;
+		stats.reroot_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		sweeper.start([this] { sweep(); });
+	}
+
+	// Compacts the arena to the tree of the root.
+	void sweep() {
+		const auto start = std::chrono::steady_clock::now();
+		root = tree.compact(root);
+		stats.nodes = tree.used();
+		stats.bytes = tree.bytes_used();
+		stats.sweep_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string to_string(const std::uint32_t index, const int i) const {
+		const TreeNode& node = tree[index];
+		std::string str = "";
+		str += std::to_string(i);
+		str += ' ';
+		if (node.evaluated) {
+			str += std::to_string(node.evaluation);
+		}
+		else {
+			str += "NaN";
+		}
+		str += " ";
+		str += node.get_move().to_string();
+		str += '\n';
+		for (std::uint32_t idx = 0; node.first_child != NONE && idx < node.num_children; ++idx) {
+			str += to_string(node.first_child + idx, i + 1);
+		}
+		return str;
+	}
 	
 public:
-	static int eval_leaf(const Node& node) {
-		const Board board = node.get_board();
-
+	// Value of `board` for the player to move, `prev` being the position before.
+	static int eval_leaf(const Board& board, const Board& prev) {
 		const BitBoard& self_board = board.get_self();
 		const BitBoard& opponent_board = board.get_opponent();
 
@@ -224,14 +239,7 @@ public:
 			else return 0;
 		}
 		const BitBoard& self_candidates = board.get_candidates();
-		Node* p = node.get_parent();
-		if (!p) {
-			auto b = p->get_board();
-		}
-		else {
-			auto b = p->get_board();
-		}
-		const BitBoard& opponent_candidates = node.get_parent()->get_board().get_candidates();
+		const BitBoard& opponent_candidates = prev.get_candidates();
 
 
 		const int n_self_candidates = count_stones(self_candidates);
@@ -278,63 +286,87 @@ public:
 		return score;
 	}
 
-	MemorizedNegaAlphaAI(const double depth_ = 3) : AI(), depth(depth_) {};
+	// `tree_mb`: size of the arena of the tree.
+	MemorizedNegaAlphaAI(const double depth_ = 3, const size_t tree_mb = 256) : AI(), depth(depth_), tree(tree_mb) {
+		reset_tree();
+	}
 
 	void load_board(const Board& board_) override {
+		sweeper.join();
 		AI::load_board(board_);
-		root = std::make_shared<Node>(board);
+		reset_tree();
+		evaluation = 0;
 	}
 
 	double eval() const override {
-		return -root->get_eval();
+		return evaluation;
 	}
 
 	void play(const Cell& move) override {
 		AI::play(move);
-		root = root->play(move);
+		reroot(move.is_pass() ? 0x0LL : from_cell(move));
 	}
 
 	Cell choose_move() override {
 		std::chrono::system_clock::time_point  start, end;
 		start = std::chrono::system_clock::now();
 
-		if (root->get_children().empty()) {
-			root->create_children();
-		}
-
-		//std::vector<std::thread> threads;
+		sweeper.join();
+		TreeNode local[ChildBatch::CAPACITY];
+		int size = 0;
+		TreeNode* const children = children_of(tree[root], board, true, local, size);
+		const bool stored = children != local;
 
 		cnt = 0;
 
-
-		for (auto& child : root->get_children()) {
-			//threads.emplace_back(std::thread(&MemorizedNegaAlphaAI::alpha_beta, std::ref(*child), depth, INT_MIN + 1, INT_MAX - 1));
-			alpha_beta(*child, depth, INT_MIN + 1, INT_MAX - 1);
+		for (int idx = 0; idx < size; ++idx) {
+			TreeNode& child = children[idx];
+			alpha_beta(child, child.play(board), board, depth, INT_MIN + 1, INT_MAX - 1, stored);
 		}
-		//for (auto& thd : threads)
-		//{
-		//	thd.join();
-		//}
 
 		std::cout << "count: " << cnt << std::endl;
 
-		root->sort_children();
-		const auto& children = root->get_children();
-		for (auto& s : children) {
-			std::cout << s->get_prev_move().to_string() << ": " << s->get_eval() << ", ";
+		sort_children(children, size);
+		for (int idx = 0; idx < size; ++idx) {
+			std::cout << children[idx].get_move().to_string() << ": " << children[idx].evaluation << ", ";
 		}
 		std::cout << std::endl;
-		auto& next = children.at(0);
-		root->set_eval(-next->get_eval());
+		const TreeNode& next = children[0];
+		tree[root].set_eval(-next.evaluation);
+		evaluation = next.evaluation;
+
+		stats.nodes = tree.used();
+		stats.bytes = tree.bytes_used();
+		std::cout << "tree: " << stats.nodes << " nodes (" << stats.bytes / 1024 << " KB), re-root: " << stats.reroot_us
+			<< " us (" << stats.sweep_wait_us << " us waiting for the sweep), sweep: " << stats.sweep_ms << " ms" << std::endl;
 
 		end = std::chrono::system_clock::now();
 		elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-		return next->get_prev_move();
+		return next.get_move();
 	}
 
 	void pass() override {
 		AI::pass();
-		root = root->play(Cell::Pass());
+		reroot(0x0LL);
+	}
+
+	void clear() override {
+		sweeper.join();
+		AI::clear();
+		reset_tree();
+		evaluation = 0;
+	}
+
+	// Size of the tree after the last search, and time of the last re-root and sweep.
+	const TreeStats& tree_stats() {
+		sweeper.join();
+		return stats;
+	}
+
+	// One line per node, depth first: its depth, value and move.
+	std::string tree_to_string() {
+		sweeper.join();
+		return to_string(root, 0);
 	}
 };
\ No newline at end of file
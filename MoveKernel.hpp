@@ -0,0 +1,394 @@
+#pragma once
+
+#include "BitBoard.hpp"
+
+/**
+Move generation kernels
+
+The scalar kernels in BitBoard.hpp walk the four line directions one after another.
+On x64 the same parallel-prefix fill is also available with the directions packed into
+the lanes of one vector register:
+
+AVX2:    4 lanes, shifts (1, 8, 7, 9), forward and backward fills in two registers
+AVX-512: 8 lanes, forward fills in lanes 0-3 and backward fills in lanes 4-7
+
+Searches also need every child of a node at once: the children kernels take all the
+candidates of a position and return the flip mask and mobility of each child.
+
+The kernel is chosen once at startup from the CPU features, falling back to scalar.
+*/
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MOVE_KERNEL_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#else
+#define MOVE_KERNEL_X64 0
+#endif
+
+using CandidatesKernel = BitBoard(*)(const BitBoard&, const BitBoard&);
+using FlippedKernel = BitBoard(*)(const BitBoard&, const BitBoard&, const BitBoard&);
+
+// Every child of one position, in structure-of-arrays form so that a batch kernel can
+// load and store whole registers. The arrays are padded to a multiple of 8 children.
+struct ChildBatch {
+	static constexpr int CAPACITY = BOARD_AREA;
+
+	int size = 0;
+	alignas(64) BitBoard move[CAPACITY];
+	alignas(64) BitBoard flipped[CAPACITY];
+	alignas(64) BitBoard candidates[CAPACITY];	// candidates of the player to move in the child
+
+	// Lists the moves and pads them with passes up to a multiple of `width`.
+	void set_moves(BitBoard moves, const int width) {
+		size = 0;
+		while (!is_empty(moves)) {
+			move[size++] = moves & (~moves + 1);
+			moves &= moves - 1;
+		}
+		for (int idx = size; idx % width != 0; ++idx) move[idx] = 0x0LL;
+	}
+};
+
+using ChildrenKernel = void(*)(const BitBoard&, const BitBoard&, const BitBoard&, ChildBatch&);
+
+struct MoveKernel {
+	std::string name;
+	CandidatesKernel candidates;
+	FlippedKernel flipped;
+	ChildrenKernel children;
+};
+
+// Fills `out` with every move in `moves`, its flip mask and the mobility of the child.
+void calculate_children(const BitBoard& self, const BitBoard& opponent, const BitBoard& moves, ChildBatch& out) {
+	out.set_moves(moves, 1);
+	for (int idx = 0; idx < out.size; ++idx) {
+		const BitBoard flipped = calculate_flipped(self, opponent, out.move[idx]);
+		out.flipped[idx] = flipped;
+		out.candidates[idx] = calculate_candidates(opponent ^ flipped, self | out.move[idx] | flipped);
+	}
+}
+
+#if MOVE_KERNEL_X64
+
+TARGET_AVX2 inline BitBoard reduce_or(const __m256i& v) {
+	const __m128i half = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	return (BitBoard)_mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
+
+TARGET_AVX2 inline __m256i avx2_inner(const BitBoard& opponent) {
+	return _mm256_and_si256(_mm256_set1_epi64x((long long)opponent),
+		_mm256_set_epi64x((long long)DIAGONAL_INNER_MASK, (long long)DIAGONAL_INNER_MASK,
+			(long long)VERTICAL_INNER_MASK, (long long)HORIZONTAL_INNER_MASK));
+}
+
+TARGET_AVX2 inline __m256i avx2_fill_forward(const __m256i& from, const __m256i& inner, const __m256i& shift, const __m256i& shift_2) {
+	__m256i line = _mm256_and_si256(inner, _mm256_sllv_epi64(from, shift));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner, _mm256_sllv_epi64(line, shift)));
+	const __m256i inner_2 = _mm256_and_si256(inner, _mm256_sllv_epi64(inner, shift));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner_2, _mm256_sllv_epi64(line, shift_2)));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner_2, _mm256_sllv_epi64(line, shift_2)));
+	return line;
+}
+
+TARGET_AVX2 inline __m256i avx2_fill_backward(const __m256i& from, const __m256i& inner, const __m256i& shift, const __m256i& shift_2) {
+	__m256i line = _mm256_and_si256(inner, _mm256_srlv_epi64(from, shift));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner, _mm256_srlv_epi64(line, shift)));
+	const __m256i inner_2 = _mm256_and_si256(inner, _mm256_srlv_epi64(inner, shift));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner_2, _mm256_srlv_epi64(line, shift_2)));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner_2, _mm256_srlv_epi64(line, shift_2)));
+	return line;
+}
+
+TARGET_AVX2 BitBoard calculate_candidates_avx2(const BitBoard& self, const BitBoard& opponent) {
+	const __m256i shift = _mm256_set_epi64x(BOARD_SIZE + 1, BOARD_SIZE - 1, BOARD_SIZE, 1);
+	const __m256i shift_2 = _mm256_add_epi64(shift, shift);
+	const __m256i inner = avx2_inner(opponent);
+	const __m256i from = _mm256_set1_epi64x((long long)self);
+
+	const __m256i forward = _mm256_sllv_epi64(avx2_fill_forward(from, inner, shift, shift_2), shift);
+	const __m256i backward = _mm256_srlv_epi64(avx2_fill_backward(from, inner, shift, shift_2), shift);
+
+	return reduce_or(_mm256_or_si256(forward, backward)) & ~(self | opponent);
+}
+
+TARGET_AVX2 BitBoard calculate_flipped_avx2(const BitBoard& self, const BitBoard& opponent, const BitBoard& move) {
+	const __m256i shift = _mm256_set_epi64x(BOARD_SIZE + 1, BOARD_SIZE - 1, BOARD_SIZE, 1);
+	const __m256i shift_2 = _mm256_add_epi64(shift, shift);
+	const __m256i inner = avx2_inner(opponent);
+	const __m256i from = _mm256_set1_epi64x((long long)move);
+	const __m256i self_v = _mm256_set1_epi64x((long long)self);
+	const __m256i zero = _mm256_setzero_si256();
+
+	const __m256i forward = avx2_fill_forward(from, inner, shift, shift_2);
+	const __m256i forward_outflank = _mm256_and_si256(_mm256_sllv_epi64(forward, shift), self_v);
+	const __m256i backward = avx2_fill_backward(from, inner, shift, shift_2);
+	const __m256i backward_outflank = _mm256_and_si256(_mm256_srlv_epi64(backward, shift), self_v);
+
+	// andnot drops the lines whose outflank is empty
+	const __m256i flipped = _mm256_or_si256(
+		_mm256_andnot_si256(_mm256_cmpeq_epi64(forward_outflank, zero), forward),
+		_mm256_andnot_si256(_mm256_cmpeq_epi64(backward_outflank, zero), backward));
+
+	return reduce_or(flipped);
+}
+
+// Lanes 4-7 shift right, lanes 0-3 shift left.
+constexpr __mmask8 BACKWARD_LANES = 0xf0;
+
+TARGET_AVX512 inline __m512i avx512_shift(const __m512i& board, const __m512i& shift) {
+	return _mm512_mask_srlv_epi64(_mm512_sllv_epi64(board, shift), BACKWARD_LANES, board, shift);
+}
+
+TARGET_AVX512 inline BitBoard avx512_reduce_or(const __m512i& v) {
+	const __m256i half = _mm256_or_si256(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1));
+	const __m128i quarter = _mm_or_si128(_mm256_castsi256_si128(half), _mm256_extracti128_si256(half, 1));
+	return (BitBoard)_mm_cvtsi128_si64(_mm_or_si128(quarter, _mm_unpackhi_epi64(quarter, quarter)));
+}
+
+TARGET_AVX512 inline __m512i avx512_fill(const __m512i& from, const __m512i& inner, const __m512i& shift, const __m512i& shift_2) {
+	__m512i line = _mm512_and_si512(inner, avx512_shift(from, shift));
+	line = _mm512_or_si512(line, _mm512_and_si512(inner, avx512_shift(line, shift)));
+	const __m512i inner_2 = _mm512_and_si512(inner, avx512_shift(inner, shift));
+	line = _mm512_or_si512(line, _mm512_and_si512(inner_2, avx512_shift(line, shift_2)));
+	line = _mm512_or_si512(line, _mm512_and_si512(inner_2, avx512_shift(line, shift_2)));
+	return line;
+}
+
+TARGET_AVX512 inline __m512i avx512_inner(const BitBoard& opponent) {
+	return _mm512_and_si512(_mm512_set1_epi64((long long)opponent),
+		_mm512_set_epi64((long long)DIAGONAL_INNER_MASK, (long long)DIAGONAL_INNER_MASK,
+			(long long)VERTICAL_INNER_MASK, (long long)HORIZONTAL_INNER_MASK,
+			(long long)DIAGONAL_INNER_MASK, (long long)DIAGONAL_INNER_MASK,
+			(long long)VERTICAL_INNER_MASK, (long long)HORIZONTAL_INNER_MASK));
+}
+
+TARGET_AVX512 inline __m512i avx512_shifts() {
+	return _mm512_set_epi64(BOARD_SIZE + 1, BOARD_SIZE - 1, BOARD_SIZE, 1, BOARD_SIZE + 1, BOARD_SIZE - 1, BOARD_SIZE, 1);
+}
+
+TARGET_AVX512 BitBoard calculate_candidates_avx512(const BitBoard& self, const BitBoard& opponent) {
+	const __m512i shift = avx512_shifts();
+	const __m512i shift_2 = _mm512_add_epi64(shift, shift);
+	const __m512i line = avx512_fill(_mm512_set1_epi64((long long)self), avx512_inner(opponent), shift, shift_2);
+
+	return avx512_reduce_or(avx512_shift(line, shift)) & ~(self | opponent);
+}
+
+TARGET_AVX512 BitBoard calculate_flipped_avx512(const BitBoard& self, const BitBoard& opponent, const BitBoard& move) {
+	const __m512i shift = avx512_shifts();
+	const __m512i shift_2 = _mm512_add_epi64(shift, shift);
+	const __m512i line = avx512_fill(_mm512_set1_epi64((long long)move), avx512_inner(opponent), shift, shift_2);
+	const __m512i outflank = _mm512_and_si512(avx512_shift(line, shift), _mm512_set1_epi64((long long)self));
+
+	// keep only the lanes whose outflank is non-empty
+	return avx512_reduce_or(_mm512_maskz_mov_epi64(_mm512_test_epi64_mask(outflank, outflank), line));
+}
+
+/*
+Batch kernels: one child per lane. All lanes share the direction, so the shifts are
+immediates and the eight directions are unrolled; the flip masks of the children are
+computed first and their mobility right after, without leaving the registers.
+*/
+
+template <int S>
+TARGET_AVX2 inline __m256i avx2_batch_shift(const __m256i& board) {
+	return (S > 0) ? _mm256_slli_epi64(board, S > 0 ? S : 0) : _mm256_srli_epi64(board, S < 0 ? -S : 0);
+}
+
+template <int S>
+TARGET_AVX2 inline __m256i avx2_batch_fill(const __m256i& from, const __m256i& inner) {
+	__m256i line = _mm256_and_si256(inner, avx2_batch_shift<S>(from));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner, avx2_batch_shift<S>(line)));
+	const __m256i inner_2 = _mm256_and_si256(inner, avx2_batch_shift<S>(inner));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner_2, avx2_batch_shift<2 * S>(line)));
+	line = _mm256_or_si256(line, _mm256_and_si256(inner_2, avx2_batch_shift<2 * S>(line)));
+	return line;
+}
+
+template <int S>
+TARGET_AVX2 inline __m256i avx2_batch_flipped(const __m256i& self, const __m256i& inner, const __m256i& move) {
+	const __m256i line = avx2_batch_fill<S>(move, inner);
+	const __m256i outflank = _mm256_and_si256(avx2_batch_shift<S>(line), self);
+	return _mm256_andnot_si256(_mm256_cmpeq_epi64(outflank, _mm256_setzero_si256()), line);
+}
+
+template <int S>
+TARGET_AVX2 inline __m256i avx2_batch_candidates(const __m256i& self, const __m256i& inner) {
+	return avx2_batch_shift<S>(avx2_batch_fill<S>(self, inner));
+}
+
+TARGET_AVX2 void calculate_children_avx2(const BitBoard& self, const BitBoard& opponent, const BitBoard& moves, ChildBatch& out) {
+	out.set_moves(moves, 4);
+	const __m256i self_v = _mm256_set1_epi64x((long long)self);
+	const __m256i opponent_v = _mm256_set1_epi64x((long long)opponent);
+	const __m256i horizontal = _mm256_set1_epi64x((long long)HORIZONTAL_INNER_MASK);
+	const __m256i vertical = _mm256_set1_epi64x((long long)VERTICAL_INNER_MASK);
+	const __m256i diagonal = _mm256_set1_epi64x((long long)DIAGONAL_INNER_MASK);
+
+	const __m256i inner_h = _mm256_and_si256(opponent_v, horizontal);
+	const __m256i inner_v = _mm256_and_si256(opponent_v, vertical);
+	const __m256i inner_d = _mm256_and_si256(opponent_v, diagonal);
+
+	for (int idx = 0; idx < out.size; idx += 4) {
+		const __m256i move = _mm256_load_si256((const __m256i*)(out.move + idx));
+
+		__m256i flipped = _mm256_or_si256(
+			_mm256_or_si256(avx2_batch_flipped<1>(self_v, inner_h, move), avx2_batch_flipped<-1>(self_v, inner_h, move)),
+			_mm256_or_si256(avx2_batch_flipped<BOARD_SIZE>(self_v, inner_v, move), avx2_batch_flipped<-BOARD_SIZE>(self_v, inner_v, move)));
+		flipped = _mm256_or_si256(flipped, _mm256_or_si256(
+			_mm256_or_si256(avx2_batch_flipped<BOARD_SIZE - 1>(self_v, inner_d, move), avx2_batch_flipped<1 - BOARD_SIZE>(self_v, inner_d, move)),
+			_mm256_or_si256(avx2_batch_flipped<BOARD_SIZE + 1>(self_v, inner_d, move), avx2_batch_flipped<-BOARD_SIZE - 1>(self_v, inner_d, move))));
+		_mm256_store_si256((__m256i*)(out.flipped + idx), flipped);
+
+		const __m256i child_self = _mm256_xor_si256(opponent_v, flipped);
+		const __m256i child_opponent = _mm256_or_si256(_mm256_or_si256(self_v, move), flipped);
+		const __m256i child_h = _mm256_and_si256(child_opponent, horizontal);
+		const __m256i child_v = _mm256_and_si256(child_opponent, vertical);
+		const __m256i child_d = _mm256_and_si256(child_opponent, diagonal);
+
+		__m256i candidates = _mm256_or_si256(
+			_mm256_or_si256(avx2_batch_candidates<1>(child_self, child_h), avx2_batch_candidates<-1>(child_self, child_h)),
+			_mm256_or_si256(avx2_batch_candidates<BOARD_SIZE>(child_self, child_v), avx2_batch_candidates<-BOARD_SIZE>(child_self, child_v)));
+		candidates = _mm256_or_si256(candidates, _mm256_or_si256(
+			_mm256_or_si256(avx2_batch_candidates<BOARD_SIZE - 1>(child_self, child_d), avx2_batch_candidates<1 - BOARD_SIZE>(child_self, child_d)),
+			_mm256_or_si256(avx2_batch_candidates<BOARD_SIZE + 1>(child_self, child_d), avx2_batch_candidates<-BOARD_SIZE - 1>(child_self, child_d))));
+		candidates = _mm256_andnot_si256(_mm256_or_si256(child_self, child_opponent), candidates);
+		_mm256_store_si256((__m256i*)(out.candidates + idx), candidates);
+	}
+}
+
+template <int S>
+TARGET_AVX512 inline __m512i avx512_batch_shift(const __m512i& board) {
+	return (S > 0) ? _mm512_slli_epi64(board, S > 0 ? S : 0) : _mm512_srli_epi64(board, S < 0 ? -S : 0);
+}
+
+template <int S>
+TARGET_AVX512 inline __m512i avx512_batch_fill(const __m512i& from, const __m512i& inner) {
+	__m512i line = _mm512_and_si512(inner, avx512_batch_shift<S>(from));
+	line = _mm512_or_si512(line, _mm512_and_si512(inner, avx512_batch_shift<S>(line)));
+	const __m512i inner_2 = _mm512_and_si512(inner, avx512_batch_shift<S>(inner));
+	line = _mm512_or_si512(line, _mm512_and_si512(inner_2, avx512_batch_shift<2 * S>(line)));
+	line = _mm512_or_si512(line, _mm512_and_si512(inner_2, avx512_batch_shift<2 * S>(line)));
+	return line;
+}
+
+template <int S>
+TARGET_AVX512 inline __m512i avx512_batch_flipped(const __m512i& self, const __m512i& inner, const __m512i& move) {
+	const __m512i line = avx512_batch_fill<S>(move, inner);
+	const __m512i outflank = _mm512_and_si512(avx512_batch_shift<S>(line), self);
+	return _mm512_maskz_mov_epi64(_mm512_test_epi64_mask(outflank, outflank), line);
+}
+
+template <int S>
+TARGET_AVX512 inline __m512i avx512_batch_candidates(const __m512i& self, const __m512i& inner) {
+	return avx512_batch_shift<S>(avx512_batch_fill<S>(self, inner));
+}
+
+TARGET_AVX512 void calculate_children_avx512(const BitBoard& self, const BitBoard& opponent, const BitBoard& moves, ChildBatch& out) {
+	out.set_moves(moves, 8);
+	const __m512i self_v = _mm512_set1_epi64((long long)self);
+	const __m512i opponent_v = _mm512_set1_epi64((long long)opponent);
+	const __m512i horizontal = _mm512_set1_epi64((long long)HORIZONTAL_INNER_MASK);
+	const __m512i vertical = _mm512_set1_epi64((long long)VERTICAL_INNER_MASK);
+	const __m512i diagonal = _mm512_set1_epi64((long long)DIAGONAL_INNER_MASK);
+
+	const __m512i inner_h = _mm512_and_si512(opponent_v, horizontal);
+	const __m512i inner_v = _mm512_and_si512(opponent_v, vertical);
+	const __m512i inner_d = _mm512_and_si512(opponent_v, diagonal);
+
+	for (int idx = 0; idx < out.size; idx += 8) {
+		const __m512i move = _mm512_load_si512((const void*)(out.move + idx));
+
+		__m512i flipped = _mm512_or_si512(
+			_mm512_or_si512(avx512_batch_flipped<1>(self_v, inner_h, move), avx512_batch_flipped<-1>(self_v, inner_h, move)),
+			_mm512_or_si512(avx512_batch_flipped<BOARD_SIZE>(self_v, inner_v, move), avx512_batch_flipped<-BOARD_SIZE>(self_v, inner_v, move)));
+		flipped = _mm512_or_si512(flipped, _mm512_or_si512(
+			_mm512_or_si512(avx512_batch_flipped<BOARD_SIZE - 1>(self_v, inner_d, move), avx512_batch_flipped<1 - BOARD_SIZE>(self_v, inner_d, move)),
+			_mm512_or_si512(avx512_batch_flipped<BOARD_SIZE + 1>(self_v, inner_d, move), avx512_batch_flipped<-BOARD_SIZE - 1>(self_v, inner_d, move))));
+		_mm512_store_si512((void*)(out.flipped + idx), flipped);
+
+		const __m512i child_self = _mm512_xor_si512(opponent_v, flipped);
+		const __m512i child_opponent = _mm512_or_si512(_mm512_or_si512(self_v, move), flipped);
+		const __m512i child_h = _mm512_and_si512(child_opponent, horizontal);
+		const __m512i child_v = _mm512_and_si512(child_opponent, vertical);
+		const __m512i child_d = _mm512_and_si512(child_opponent, diagonal);
+
+		__m512i candidates = _mm512_or_si512(
+			_mm512_or_si512(avx512_batch_candidates<1>(child_self, child_h), avx512_batch_candidates<-1>(child_self, child_h)),
+			_mm512_or_si512(avx512_batch_candidates<BOARD_SIZE>(child_self, child_v), avx512_batch_candidates<-BOARD_SIZE>(child_self, child_v)));
+		candidates = _mm512_or_si512(candidates, _mm512_or_si512(
+			_mm512_or_si512(avx512_batch_candidates<BOARD_SIZE - 1>(child_self, child_d), avx512_batch_candidates<1 - BOARD_SIZE>(child_self, child_d)),
+			_mm512_or_si512(avx512_batch_candidates<BOARD_SIZE + 1>(child_self, child_d), avx512_batch_candidates<-BOARD_SIZE - 1>(child_self, child_d))));
+		candidates = _mm512_andnot_si512(_mm512_or_si512(child_self, child_opponent), candidates);
+		_mm512_store_si512((void*)(out.candidates + idx), candidates);
+	}
+}
+
+#ifdef _MSC_VER
+inline bool os_saves_ymm_zmm(const bool zmm) {
+	const unsigned long long xcr0 = _xgetbv(0);
+	const unsigned long long required = zmm ? 0xe6 : 0x06;
+	return (xcr0 & required) == required;
+}
+
+inline bool cpu_supports_avx2() {
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	__cpuidex(info, 7, 0);
+	return osxsave && (info[1] & (1 << 5)) != 0 && os_saves_ymm_zmm(false);
+}
+
+inline bool cpu_supports_avx512() {
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	__cpuidex(info, 7, 0);
+	return osxsave && (info[1] & (1 << 16)) != 0 && os_saves_ymm_zmm(true);
+}
+#else
+inline bool cpu_supports_avx2() { return __builtin_cpu_supports("avx2"); }
+
+inline bool cpu_supports_avx512() { return __builtin_cpu_supports("avx512f"); }
+#endif
+
+#endif
+
+inline std::vector<MoveKernel> available_move_kernels() {
+	std::vector<MoveKernel> kernels;
+#if MOVE_KERNEL_X64
+	if (cpu_supports_avx512()) {
+		kernels.push_back({ "avx512", calculate_candidates_avx512, calculate_flipped_avx512, calculate_children_avx512 });
+	}
+	if (cpu_supports_avx2()) {
+		kernels.push_back({ "avx2", calculate_candidates_avx2, calculate_flipped_avx2, calculate_children_avx2 });
+	}
+#endif
+	kernels.push_back({ "scalar", calculate_candidates, calculate_flipped, calculate_children });
+	return kernels;
+}
+
+// Selected at startup. Use select_move_kernel() to pin a specific kernel (e.g. for benchmarks).
+static MoveKernel move_kernel = available_move_kernels().front();
+
+bool select_move_kernel(const std::string& name) {
+	for (auto& kernel : available_move_kernels()) {
+		if (kernel.name == name) {
+			move_kernel = kernel;
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
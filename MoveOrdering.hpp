@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include "BitBoard.hpp"
+#include "SearchBoard.hpp"
+#include "ParallelSearch.hpp"
+
+/**
+Move ordering learned during the search
+
+The static ordering of the engines is refined with what the search finds out:
+- the best move stored in the transposition table for the position comes first,
+- then the moves by their static score, plus a bonus for the killer moves of the ply, the last two
+  moves which caused a cutoff at that ply in another subtree, and a history score: each cutoff
+  credits its move, on its square and in its game phase, with the square of the depth left.
+
+How much the killers and the history weigh against the static score is up to each engine, the
+static scores having their own scales.
+
+Each thread of the pool has its own tables, so the search never synchronizes on them. The history
+is only halved from one search to the next, since most of it still applies a move later; the
+killers are forgotten, their plies being counted from another root.
+
+The statistics count the nodes cut off, and among them those cut by the first move searched: the
+closer the rate to 1, the better the ordering.
+*/
+
+struct OrderingStats {
+	long long cutoffs = 0;
+	long long first_move_cutoffs = 0;
+
+	double first_move_rate() const {
+		return (cutoffs > 0) ? (double)first_move_cutoffs / cutoffs : 0.0;
+	}
+
+	OrderingStats& operator+=(const OrderingStats& other) {
+		cutoffs += other.cutoffs;
+		first_move_cutoffs += other.first_move_cutoffs;
+		return *this;
+	}
+};
+
+// Weights of the learned scores, on the scale of the static scores of an engine.
+struct OrderingWeights {
+	int killer;		// bonus of the first killer, half of it for the second
+	int history;	// history score of a move at MoveHistory::HISTORY_MAX
+};
+
+// The ordering tables of one thread.
+class MoveHistory {
+public:
+	static constexpr int NUM_PHASES = 4;	// empties 0-15, 16-31, 32-47, 48-60
+	static constexpr int NUM_KILLERS = 2;
+	static constexpr int MAX_PLY = 2 * BOARD_AREA;
+	// the history of a phase is halved once an entry goes beyond
+	static constexpr int HISTORY_MAX = 1 << 16;
+
+	// score of the best move of the transposition table, ahead of all
+	static constexpr int TABLE_SCORE = INT_MAX;
+
+private:
+	int history[NUM_PHASES][BOARD_AREA];
+	BitBoard killers[MAX_PLY + 1][NUM_KILLERS];
+	OrderingStats counts;
+
+	static int phase_of(const int empties) {
+		return std::min(empties / 16, NUM_PHASES - 1);
+	}
+
+	// the deepest plies share the last killers
+	static int killer_ply(const int ply) {
+		return (ply < MAX_PLY) ? ply : MAX_PLY;
+	}
+
+public:
+	MoveHistory() { clear(); }
+
+	// Ordering score of `move`, of static score `static_score`, at a node with `empties` empty cells
+	// at `ply` whose best move in the transposition table is `table_move` (empty if none).
+	int score(const BitBoard& move, const int static_score, const int empties, const int ply, const BitBoard& table_move,
+		const OrderingWeights& weights) const {
+		if (move == table_move) return TABLE_SCORE;
+		int score = static_score + (int)((long long)history[phase_of(empties)][lsb_loc(move)] * weights.history / HISTORY_MAX);
+		const BitBoard* killer = killers[killer_ply(ply)];
+		for (int slot = 0; slot < NUM_KILLERS; ++slot) {
+			if (move == killer[slot]) score += weights.killer >> slot;
+		}
+		return score;
+	}
+
+	// `move` cut off a node with `depth` left; `first`: it was the first move searched.
+	void cutoff(const BitBoard& move, const int empties, const int ply, const int depth, const bool first) {
+		counts.cutoffs++;
+		if (first) counts.first_move_cutoffs++;
+
+		int* phase = history[phase_of(empties)];
+		int& entry = phase[lsb_loc(move)];
+		entry += depth * depth;
+		if (entry > HISTORY_MAX) {
+			for (int loc = 0; loc < BOARD_AREA; ++loc) phase[loc] /= 2;
+		}
+
+		BitBoard* killer = killers[killer_ply(ply)];
+		if (killer[0] != move) {
+			killer[1] = killer[0];
+			killer[0] = move;
+		}
+	}
+
+	void new_search() {
+		for (auto& phase : history) {
+			for (auto& entry : phase) entry /= 2;
+		}
+		std::fill(&killers[0][0], &killers[0][0] + (MAX_PLY + 1) * NUM_KILLERS, 0x0LL);
+	}
+
+	void clear() {
+		std::fill(&history[0][0], &history[0][0] + NUM_PHASES * BOARD_AREA, 0);
+		std::fill(&killers[0][0], &killers[0][0] + (MAX_PLY + 1) * NUM_KILLERS, 0x0LL);
+	}
+
+	const OrderingStats& stats() const { return counts; }
+
+	void reset_stats() { counts = OrderingStats(); }
+};
+
+// The tables of every thread of the shared pool, for one engine, and of one background thread. The
+// threads outside the pool share the first ones, so only one of them may search at a time besides
+// the background one.
+class MoveOrdering {
+private:
+	std::vector<MoveHistory> threads;
+
+public:
+	MoveOrdering() : threads(ThreadPool::shared().size() + 1) {};
+
+	// The tables of the current thread.
+	MoveHistory& local() {
+		const int index = ThreadPool::thread_index();
+		return threads[(index >= 0) ? (size_t)index : threads.size() - 1];
+	}
+
+	// Sorts `children`, scored statically from the point of view of the player to move, best first.
+	void sort(ChildList& children, const int empties, const int ply, const BitBoard& table_move, const OrderingWeights& weights) {
+		const MoveHistory& tables = local();
+		for (auto& child : children) {
+			child.score = tables.score(child.move, child.score, empties, ply, table_move, weights);
+		}
+		children.sort_by_score();
+	}
+
+	void new_search() {
+		for (auto& tables : threads) tables.new_search();
+	}
+
+	void clear() {
+		for (auto& tables : threads) tables.clear();
+	}
+
+	// Statistics of all the threads since the last reset_stats(), which clear() keeps. Not to be
+	// read during a search.
+	OrderingStats stats() const {
+		OrderingStats out;
+		for (const auto& tables : threads) out += tables.stats();
+		return out;
+	}
+
+	void reset_stats() {
+		for (auto& tables : threads) tables.reset_stats();
+	}
+};
@@ -5,6 +5,9 @@
 #include <algorithm>
 
 #include "AI.hpp"
+#include "SearchBoard.hpp"
+#include "ParallelSearch.hpp"
+#include "MoveOrdering.hpp"
 
 class NegaAlphaAI : public AI {
 private:
@@ -12,11 +15,17 @@ private:
 	int evaluation;
 	std::mutex mtx;
 	Cell move;
+	bool principal_variation = true;
+	MoveOrdering ordering;
+	// weights of the killers and of the history on the scale of evaluate_child(): without a
+	// transposition table, the killers come first
+	static constexpr int KILLER_WEIGHT = 1 << 10;
+	static constexpr int HISTORY_WEIGHT = 256;
 
-	using BoardInfo = std::pair<Board, Cell>;
-	
-	static int evaluate(const BoardInfo& board_info, const Board& prev) {
-		const Board board = board_info.first;
+	// reduction of the children from the 10th on, less than in the other engines
+	static constexpr double LATE_REDUCTION = 2.3;
+
+	static int evaluate(SearchBoard& board) {
 
 		const BitBoard& self_board = board.get_self();
 		const BitBoard& opponent_board = board.get_opponent();
@@ -31,8 +40,8 @@ private:
 			else return 0;
 		}
 
-		const BitBoard& self_candidates = board.get_candidates();
-		const BitBoard& opponent_candidates = prev.get_candidates();
+		const BitBoard self_candidates = board.get_candidates();
+		const BitBoard opponent_candidates = board.get_prev_candidates();
 
 
 		const int n_self_candidates = count_stones(self_candidates);
@@ -80,78 +89,97 @@ private:
 	}
 
 	static int openness(const BitBoard& empty, const Cell& cell) {
-		BitBoard stone = from_cell(cell);
-		int cnt = 0;
-		for (auto& dir : ALL_DIRS) {
-			if (!is_empty(translate(stone, dir) & empty)) {
-				cnt++;
-			}
-		}
-		return cnt;
+		const BitBoard stone = from_cell(cell);
+		return count_stones(neighbours(stone) & empty);
 	}
 
-	static int evaluate_boardInfo(const BoardInfo& board_info) {
-		const Board& board = board_info.first;
+	static int evaluate_child(SearchBoard& board, const BitBoard& move) {
 		const BitBoard oppo_candidates = board.get_candidates();
 		const BitBoard corner = 0x8100000000000081LL;
 
 		const int num_cand = count_stones(oppo_candidates);
 		const int num_cornoer = count_stones(oppo_candidates & corner);
 
-		const Cell& move = board_info.second;
-		const int open = openness(~(board.get_self() | board.get_opponent()), move);
+		const int open = openness(~(board.get_self() | board.get_opponent()), Cell(move));
 
 		return -num_cand - 3 * num_cornoer - 4 * open;
 	}
 
-	static std::vector<BoardInfo> sorted_children(const Board& board) {
-		auto candidates = board.get_candidate_list();
+	// Children in search order: the killers first, then by evaluate_child() and the history.
+	void sorted_children(SearchBoard& board, ChildList& children) {
+		board.generate_children(children);
+		if (children.size() == 1) return;
 
-		if (candidates.empty()) {
-			return std::vector<BoardInfo>({ std::make_pair(board.pass(), Cell::Pass()) });
-		}
-		else {
-			std::vector<BoardInfo> children(candidates.size());
-			size_t idx = 0;
-			for (auto& cell : candidates) {
-				children[idx++] = std::make_pair(board.play(cell), cell);
-			}
-			std::sort(children.begin(), children.end(),
-				[](const BoardInfo& a, const BoardInfo& b) {
-					return evaluate_boardInfo(a) > evaluate_boardInfo(b);
-				});
-			return children;
+		for (auto& child : children) {
+			board.do_move_with_candidates(child);
+			child.score = evaluate_child(board, child.move);
+			board.undo_move();
 		}
+		ordering.sort(children, count_stones(~(board.get_self() | board.get_opponent())), board.get_ply(), 0x0LL, { KILLER_WEIGHT, HISTORY_WEIGHT });
+	}
+
+	// `child`, the idx-th searched, cut off the node.
+	void record_cutoff(SearchBoard& board, const SearchMove& child, const int idx, const double depth) {
+		ordering.local().cutoff(child.move, count_stones(~(board.get_self() | board.get_opponent())), board.get_ply(),
+			std::max(1, (int)depth), idx == 0);
+	}
+
+	int search_child(SearchBoard& board, const SearchMove& child, const double depth, int alpha, int beta, const SplitPoint* split) {
+		board.do_move_with_candidates(child);
+		const int value = nega_alpha(board, depth, alpha, beta, split);
+		board.undo_move();
+		return value;
+	}
 
+	// Principal variation search of a move after the first, from the point of view of the node:
+	// a null window only tells whether the move raises alpha, and the full window is searched
+	// again only if it does.
+	int scout_child(SearchBoard& board, const SearchMove& child, const double depth, const int alpha, const int beta, const SplitPoint* split) {
+		if (principal_variation && alpha + 1 < beta) {
+			const int value = -search_child(board, child, depth, -alpha - 1, -alpha, split);
+			if (value <= alpha) return value;
+		}
+		return -search_child(board, child, depth, -beta, -alpha, split);
 	}
 
-	static int nega_alpha(const BoardInfo& board_info, const Board& prev, const double depth, int alpha, int beta) {
-		if (depth <= 0 || board_info.first.finished()) {
-			return -evaluate(board_info, prev);
+	// `split`: the closest split point above the node, if any. Its value is meaningless once cut off.
+	int nega_alpha(SearchBoard& board, const double depth, int alpha, int beta, const SplitPoint* split) {
+		if (cut_off(split)) return alpha;
+		if (depth <= 0 || board.finished()) {
+			return -evaluate(board);
 		}
 
-		std::vector<BoardInfo> children = sorted_children(board_info.first);
+		ChildList children;
+		sorted_children(board, children);
 
 		if (children.size() == 1) {
-			return std::max(alpha, -nega_alpha(children.at(0), board_info.first, depth - 0.5, -beta, -alpha));
+			return std::max(alpha, -search_child(board, children.at(0), depth - 0.5, -beta, -alpha, split));
 		}
 
-		int idx = 0;
-		for (auto& child : children) {
-			if (idx < 2) {
-				alpha = std::max(alpha, -nega_alpha(child, board_info.first, depth - 0.7, -beta, -alpha));
-			}
-			else if (idx < 5) {
-				alpha = std::max(alpha, -nega_alpha(child, board_info.first, depth - 1.0, -beta, -alpha));
+		for (int idx = 0; idx < (int)children.size(); ++idx) {
+			if (should_split(idx, depth)) {
+				split_children(split, idx, (int)children.size(), alpha, beta,
+					[&](const int child_idx, const int child_alpha, const int child_beta, const SplitPoint* child_split) {
+						SearchBoard position(board, SearchBoard::CurrentPly());
+						return scout_child(position, children.at(child_idx), depth - child_reduction(child_idx, LATE_REDUCTION), child_alpha, child_beta, child_split);
+					},
+					[&](const int child_idx, const int value) {
+						alpha = std::max(alpha, value);
+						if (alpha < beta) return false;
+						record_cutoff(board, children.at(child_idx), child_idx, depth);
+						return true;
+					});
+				return alpha;
 			}
-			else if (idx < 8) {
-				alpha = std::max(alpha, -nega_alpha(child, board_info.first, depth - 1.7, -beta, -alpha));
+			const double child_depth = depth - child_reduction(idx, LATE_REDUCTION);
+			const int value = (idx == 0)
+				? -search_child(board, children.at(idx), child_depth, -beta, -alpha, split)
+				: scout_child(board, children.at(idx), child_depth, alpha, beta, split);
+			alpha = std::max(alpha, value);
+			if (alpha >= beta) {
+				if (!cut_off(split)) record_cutoff(board, children.at(idx), idx, depth);
+				return alpha;
 			}
-			else {
-				alpha = std::max(alpha, -nega_alpha(child, board_info.first, depth - 2.3, -beta, -alpha));
-			}
-			idx++;
-			if (alpha >= beta) return alpha;
 		}
 		return alpha;
 	}
@@ -159,18 +187,45 @@ private:
 public:
 	NegaAlphaAI(const int depth_) : AI(), depth(depth_) {};
 
+	// Principal variation search (on by default), or every move with the full window.
+	void set_principal_variation(const bool enabled) {
+		principal_variation = enabled;
+	}
+
 	double eval() const override {
 		return evaluation;
 	}
 
-	void worker(const BoardInfo& child)
+	// Cutoffs of the searches since the last reset_ordering_stats(), and how many the first move
+	// made, to measure the move ordering.
+	OrderingStats ordering_stats() const {
+		return ordering.stats();
+	}
+
+	void reset_ordering_stats() {
+		ordering.reset_stats();
+	}
+
+	void worker(const SearchMove& child)
 	{
-		int tmp = nega_alpha(child, board, depth, evaluation, INT_MAX - 1);
+		int alpha;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			alpha = evaluation;
+		}
+
+		SearchBoard position(board);
+		position.do_move_with_candidates(child);
+		// the first move searched has no alpha to scout with
+		const bool scout = principal_variation && alpha > INT_MIN + 1;
+		int tmp = alpha;
+		if (scout) tmp = nega_alpha(position, depth, alpha, alpha + 1, nullptr);
+		if (!scout || tmp > alpha) tmp = nega_alpha(position, depth, alpha, INT_MAX - 1, nullptr);
 
 		std::lock_guard<std::mutex> lock(mtx);
 		if (evaluation < tmp) {
 			evaluation = tmp;
-			move = child.second;
+			move = child.to_cell();
 		}
 	}
 
@@ -178,21 +233,21 @@ public:
 		std::chrono::system_clock::time_point  start, end;
 		start = std::chrono::system_clock::now();
 
-		auto children = sorted_children(board);
-
-		std::vector<std::thread> threads;
+		ordering.new_search();
+		SearchBoard root(board);
+		ChildList children;
+		sorted_children(root, children);
 
 		evaluation = INT_MIN + 1;
 
-		for (auto& child : children) {
-			threads.push_back(std::thread(&NegaAlphaAI::worker, this, child));
-		}
-
-		for (auto& thd : threads)
-		{
-			thd.join();
+		// the first move alone, then the others in parallel with its value as alpha
+		TaskGroup group;
+		for (int idx = 0; idx < (int)children.size(); ++idx) {
+			const SearchMove& child = children.at(idx);
+			if (idx == 0) worker(child);
+			else group.run([this, &child] { worker(child); });
 		}
-
+		group.wait();
 
 		//evaluation = alpha;
 
@@ -201,4 +256,9 @@ public:
 
 		return move;
 	}
+
+	void clear() override {
+		AI::clear();
+		ordering.clear();
+	}
 };
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Board.hpp"
+
+/**
+Arena of the nodes of a search tree
+
+The nodes live in one block allocated once, at most `mb` megabytes with the bookkeeping, and
+refer to each other by 32-bit indices instead of pointers. The children of a node are allocated
+together, contiguously, so that a node only holds the index of the first one and their number.
+Allocation is a bump of the end of the used part, shared by the search threads without a lock;
+once the block is full, allocations fail and the caller searches without storing.
+
+Nothing is ever freed by itself: compact() keeps the nodes reachable from a root and slides them
+down to the start of the block, in the same order. Since the children of a node are always
+allocated after it, the order is kept by moving every node to a lower index, and the indices in
+the nodes are updated on the way. An engine evicts a subtree by unlinking it before compacting.
+
+`Node` must be trivially constructible. For compact() only, it must also be trivially copyable,
+with a `std::uint32_t first_child` (NONE without children) and a `num_children` member.
+*/
+
+template <class Node>
+class NodeArena {
+public:
+	static constexpr std::uint32_t NONE = UINT32_MAX;
+
+private:
+	std::unique_ptr<Node[]> nodes;
+	std::unique_ptr<std::uint32_t[]> forward;	// new index of each node during compact(), NONE if dropped
+	std::uint32_t capacity_ = 0;
+	std::atomic<std::uint32_t> used_{ 0 };
+
+public:
+	explicit NodeArena(const size_t mb) {
+		const size_t count = (mb << 20) / (sizeof(Node) + sizeof(std::uint32_t));
+		capacity_ = (std::uint32_t)std::min(count, (size_t)NONE);
+		nodes.reset(new Node[capacity_]);
+		forward.reset(new std::uint32_t[capacity_]);
+	}
+
+	NodeArena(const NodeArena&) = delete;
+	NodeArena& operator=(const NodeArena&) = delete;
+
+	Node& operator[](const std::uint32_t index) { return nodes[index]; }
+
+	const Node& operator[](const std::uint32_t index) const { return nodes[index]; }
+
+	// Index of the first of `count` consecutive new nodes, left uninitialized. NONE if full.
+	std::uint32_t allocate(const std::uint32_t count) {
+		std::uint32_t first = used_.load(std::memory_order_relaxed);
+		do {
+			if (count > capacity_ - first) return NONE;
+		} while (!used_.compare_exchange_weak(first, first + count, std::memory_order_relaxed));
+		return first;
+	}
+
+	std::uint32_t used() const { return used_; }
+
+	std::uint32_t capacity() const { return capacity_; }
+
+	size_t bytes_used() const { return (size_t)used() * sizeof(Node); }
+
+	void clear() { used_ = 0; }
+
+	// Drops every node not reachable from `root` and returns the new index of `root`. Not to be
+	// called during a search.
+	std::uint32_t compact(const std::uint32_t root) {
+		const std::uint32_t end = used();
+		std::fill(forward.get(), forward.get() + end, (std::uint32_t)NONE);
+
+		// mark: any value but NONE
+		std::vector<std::uint32_t> stack = { root };
+		forward[root] = 0;
+		while (!stack.empty()) {
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			if (node.first_child == NONE) continue;
+			for (std::uint32_t idx = 0; idx < (std::uint32_t)node.num_children; ++idx) {
+				forward[node.first_child + idx] = 0;
+				stack.push_back(node.first_child + idx);
+			}
+		}
+
+		std::uint32_t next = 0;
+		for (std::uint32_t idx = 0; idx < end; ++idx) {
+			if (forward[idx] != NONE) forward[idx] = next++;
+		}
+
+		// the children of a node come after it, so their new index is known before it moves
+		for (std::uint32_t idx = 0; idx < end; ++idx) {
+			if (forward[idx] == NONE) continue;
+			Node node = nodes[idx];
+			if (node.first_child != NONE) node.first_child = forward[node.first_child];
+			nodes[forward[idx]] = node;
+		}
+		used_ = next;
+		return forward[root];
+	}
+};
+
+// A node of the memorized trees: only the move leading to it, the position being replayed from the
+// root on the way down.
+struct TreeNode {
+	BitBoard move;		// the move leading to the node, empty for a pass
+	BitBoard flipped;
+	int evaluation;		// value once searched, until then a static score of the move, if any
+	std::uint32_t first_child;	// index of the first child in the arena, NONE if not created
+	unsigned char num_children;
+	bool evaluated;
+
+	static TreeNode leaf(const BitBoard& move, const BitBoard& flipped, const int score) {
+		TreeNode node;
+		node.move = move;
+		node.flipped = flipped;
+		node.evaluation = score;
+		node.first_child = NodeArena<TreeNode>::NONE;
+		node.num_children = 0;
+		node.evaluated = false;
+		return node;
+	}
+
+	// The position of the node, from the one of its parent.
+	Board play(const Board& board) const {
+		return Board(board.get_opponent() ^ flipped, board.get_self() | move | flipped);
+	}
+
+	Cell get_move() const { return is_empty(move) ? Cell::Pass() : Cell(move); }
+
+	void set_eval(const int eval) {
+		evaluation = eval;
+		evaluated = true;
+	}
+};
+
+// Index of the child of `parent` reached by `move` (empty for a pass), NONE if not created.
+inline std::uint32_t find_child(const NodeArena<TreeNode>& tree, const std::uint32_t parent, const BitBoard& move) {
+	const TreeNode& node = tree[parent];
+	if (node.first_child == NodeArena<TreeNode>::NONE) return NodeArena<TreeNode>::NONE;
+	for (std::uint32_t idx = 0; idx < node.num_children; ++idx) {
+		if (tree[node.first_child + idx].move == move) return node.first_child + idx;
+	}
+	return NodeArena<TreeNode>::NONE;
+}
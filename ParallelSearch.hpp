@@ -0,0 +1,295 @@
+#pragma once
+
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+Parallel tree search
+
+ThreadPool is a persistent pool of workers, one per hardware thread but the one of the caller.
+Each worker has its own deque of tasks: it pushes and pops at the back, and idle workers steal
+from the front of the others, i.e. the oldest and largest subtrees.
+
+The searches split a node Young Brothers Wait style: the eldest child is searched first by the
+thread owning the node, then the younger brothers are searched as tasks of a TaskGroup, with the
+bounds raised by the eldest. A thread waiting for its group runs tasks meanwhile, so nested splits
+never block a worker. A cutoff in a split point is published through SplitPoint and stops the
+tasks under it.
+*/
+
+class ThreadPool {
+private:
+	using Task = std::function<void()>;
+
+	struct Queue {
+		std::mutex mtx;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;	// [0] for the threads outside the pool
+	std::vector<std::thread> workers;
+	std::atomic<int> pending{ 0 };
+	std::atomic<bool> done{ false };
+	std::mutex sleep_mtx;
+	std::condition_variable wake;
+
+	// queue index of the current thread, 0 outside the pool
+	static int& queue_index() {
+		static thread_local int index = 0;
+		return index;
+	}
+
+	// true for a BackgroundThread
+	static bool& background() {
+		static thread_local bool flag = false;
+		return flag;
+	}
+	friend class BackgroundThread;
+
+	bool pop(const int index, Task& task) {
+		Queue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mtx);
+		if (queue.tasks.empty()) return false;
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(const int index, Task& task) {
+		Queue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mtx);
+		if (queue.tasks.empty()) return false;
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		return true;
+	}
+
+	void work(const int index) {
+		queue_index() = index;
+		while (!done) {
+			if (run_one()) continue;
+			std::unique_lock<std::mutex> lock(sleep_mtx);
+			wake.wait(lock, [this] { return done || pending > 0; });
+		}
+	}
+
+public:
+	// `num_workers` threads besides the callers, by default one less than the hardware threads.
+	explicit ThreadPool(int num_workers = -1) {
+		if (num_workers < 0) num_workers = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+		for (int idx = 0; idx <= num_workers; ++idx) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+		for (int idx = 1; idx <= num_workers; ++idx) {
+			workers.push_back(std::thread(&ThreadPool::work, this, idx));
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mtx);
+			done = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers) worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// The pool shared by all the search engines.
+	static ThreadPool& shared() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	int size() const { return (int)workers.size() + 1; }
+
+	// Index of the current thread: from 1 for the workers of a pool, 0 for the threads outside but
+	// a BackgroundThread, which gets -1. A foreground and a background thread may search at once.
+	static int thread_index() { return background() ? -1 : queue_index(); }
+
+	void submit(Task task) {
+		Queue& queue = *queues[queue_index()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mtx);
+			queue.tasks.push_back(std::move(task));
+		}
+		pending++;
+		{
+			// a worker checking `pending` before going to sleep cannot miss the notification
+			std::lock_guard<std::mutex> lock(sleep_mtx);
+		}
+		wake.notify_one();
+	}
+
+	// Runs one task, from the own queue of the thread if possible, else stolen. False if none.
+	bool run_one() {
+		if (pending == 0) return false;
+		const int own = queue_index();
+		Task task;
+		bool found = pop(own, task);
+		for (int idx = 1; !found && idx < (int)queues.size(); ++idx) {
+			found = steal((own + idx) % (int)queues.size(), task);
+		}
+		if (!found) return false;
+		pending--;
+		task();
+		return true;
+	}
+};
+
+// A thread outside of the pool running one job at a time, e.g. housekeeping in the background.
+// Starting a job joins the previous one. It is no search thread: its tasks, if any, go to the pool
+// as those of any thread outside.
+class WorkerThread {
+private:
+	std::thread thread;
+
+public:
+	WorkerThread() = default;
+
+	WorkerThread(const WorkerThread&) = delete;
+	WorkerThread& operator=(const WorkerThread&) = delete;
+
+	~WorkerThread() { join(); }
+
+	void start(std::function<void()> task) {
+		join();
+		thread = std::thread(std::move(task));
+	}
+
+	void join() {
+		if (thread.joinable()) thread.join();
+	}
+};
+
+// A thread outside of the pool searching in the background, e.g. on the opponent's time, while
+// another thread outside uses the pool. Its tasks go to the pool like those of the other one.
+class BackgroundThread {
+private:
+	WorkerThread thread;
+
+public:
+	BackgroundThread() = default;
+
+	BackgroundThread(const BackgroundThread&) = delete;
+	BackgroundThread& operator=(const BackgroundThread&) = delete;
+
+	void start(std::function<void()> task) {
+		thread.start([task] {
+			ThreadPool::background() = true;
+			task();
+		});
+	}
+
+	void join() { thread.join(); }
+};
+
+class TaskGroup {
+private:
+	ThreadPool& pool;
+	std::atomic<int> remaining{ 0 };
+
+public:
+	explicit TaskGroup(ThreadPool& pool_ = ThreadPool::shared()) : pool(pool_) {};
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	~TaskGroup() { wait(); }
+
+	int pool_size() const { return pool.size(); }
+
+	// `task` may run on any thread, or on the caller of wait().
+	void run(std::function<void()> task) {
+		remaining++;
+		pool.submit([this, task] {
+			task();
+			remaining--;
+		});
+	}
+
+	void wait() {
+		while (remaining > 0) {
+			if (!pool.run_one()) std::this_thread::yield();
+		}
+	}
+};
+
+class SplitPoint {
+private:
+	const SplitPoint* parent;
+	std::atomic<bool> cutoff{ false };
+
+public:
+	std::mutex mtx;	// guards the bounds and the best move of the node while it is split
+
+	explicit SplitPoint(const SplitPoint* parent_) : parent(parent_) {};
+
+	void cut() { cutoff.store(true, std::memory_order_relaxed); }
+
+	// True if this node or one above it was cut off: the search below is useless.
+	bool cut_off() const {
+		for (const SplitPoint* split = this; split != nullptr; split = split->parent) {
+			if (split->cutoff.load(std::memory_order_relaxed)) return true;
+		}
+		return false;
+	}
+};
+
+inline bool cut_off(const SplitPoint* split) {
+	return split != nullptr && split->cut_off();
+}
+
+// Nodes with less depth left are not split: the tasks would cost more than the search.
+constexpr double SPLIT_MIN_DEPTH = 3.0;
+
+// Depth reduction of the idx-th child in move order, `late` from the 10th on.
+inline double child_reduction(const int idx, const double late = 3.0) {
+	if (idx < 2) return 0.7;
+	if (idx < 5) return 1.0;
+	if (idx < 8) return 1.7;
+	if (idx < 10) return 2.3;
+	return late;
+}
+
+// Young brothers wait for the eldest: a node is split before its second child, if deep enough.
+inline bool should_split(const int idx, const double depth) {
+	return idx == 1 && depth >= SPLIT_MIN_DEPTH;
+}
+
+// Searches the children from `first` to `last` - 1 of a node as tasks, sharing the bounds of the
+// node. `search(idx, alpha, beta, split)` returns the value of the idx-th child searched within the
+// bounds of the node when its task starts; `update(idx, value)` takes the value into the node and
+// returns true on a cutoff. Updates are serialized, and none is made once the node is cut off.
+template <class Bound, class Search, class Update>
+void split_children(const SplitPoint* parent, const int first, const int last, Bound& alpha, Bound& beta, Search search, Update update) {
+	SplitPoint split(parent);
+	TaskGroup group;
+	for (int idx = first; idx < last; ++idx) {
+		group.run([&, idx] {
+			if (split.cut_off()) return;
+			Bound child_alpha, child_beta;
+			{
+				std::lock_guard<std::mutex> lock(split.mtx);
+				child_alpha = alpha;
+				child_beta = beta;
+			}
+
+			const auto value = search(idx, child_alpha, child_beta, &split);
+
+			std::lock_guard<std::mutex> lock(split.mtx);
+			if (split.cut_off()) return;
+			if (update(idx, value)) split.cut();
+		});
+	}
+	group.wait();
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+
+#include "Perft.hpp"
+
+void print_usage() {
+	std::cout << "usage: Perft [-d depth] [-f positions_file] [-t threads] [-H hash_mb] [-k kernel] [-a]\n"
+		<< "       Perft -c games [-s seed]\n"
+		<< "  -d  depth (default 9)\n"
+		<< "  -f  positions file, otherwise the initial position\n"
+		<< "  -t  threads, root moves are split between them (default 1)\n"
+		<< "  -H  hash table size in MB per thread (default 0: no hashing)\n"
+		<< "  -k  move kernel: avx512, avx2 or scalar (default: best available)\n"
+		<< "  -a  print every depth from 1 to depth\n"
+		<< "  -c  compare every move kernel with the reference loops on the positions of random games\n"
+		<< "      and as many random bitboards, instead of counting\n"
+		<< "  -s  random seed of the check (default 1)\n";
+}
+
+int main(int argc, char* argv[])
+{
+	int depth = 9;
+	int num_threads = 1;
+	size_t hash_mb = 0;
+	bool all_depths = false;
+	int check_games = 0;
+	unsigned int seed = 1;
+	std::string path;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "-d" && has_value) depth = std::stoi(argv[++i]);
+		else if (arg == "-f" && has_value) path = argv[++i];
+		else if (arg == "-t" && has_value) num_threads = std::stoi(argv[++i]);
+		else if (arg == "-H" && has_value) hash_mb = (size_t)std::stoul(argv[++i]);
+		else if (arg == "-k" && has_value) {
+			if (!select_move_kernel(argv[++i])) {
+				std::cout << "move kernel " << argv[i] << " is not available" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-a") all_depths = true;
+		else if (arg == "-c" && has_value) check_games = std::stoi(argv[++i]);
+		else if (arg == "-s" && has_value) seed = (unsigned int)std::stoul(argv[++i]);
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (check_games > 0) {
+		bool passed = true;
+		for (const auto& kernel : available_move_kernels()) {
+			const KernelCheck result = check_kernel(kernel, check_games, seed);
+			std::cout << kernel.name << ": " << result.positions << " positions, " << result.moves << " moves, "
+				<< result.mismatches << " mismatches" << std::endl;
+			if (result.mismatches > 0) passed = false;
+		}
+		return passed ? 0 : 1;
+	}
+
+	std::vector<Board> boards;
+	if (path.empty()) {
+		boards.push_back(Board(init_black, init_white));
+	}
+	else {
+		try {
+			boards = read_positions(path);
+		}
+		catch (const std::exception& e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "move kernel: " << move_kernel.name << ", threads: " << num_threads << ", hash: " << hash_mb << " MB" << std::endl;
+
+	PerftResult total;
+	for (size_t idx = 0; idx < boards.size(); ++idx) {
+		for (int d = all_depths ? 1 : depth; d <= depth; ++d) {
+			const PerftResult result = run_perft(boards[idx], d, num_threads, hash_mb);
+			std::cout << "position " << idx + 1 << " depth " << d << ": " << result.nodes << " nodes, "
+				<< result.elapsed << " ms, " << result.nodes_per_second() << " nodes/s" << std::endl;
+			total.nodes += result.nodes;
+			total.elapsed += result.elapsed;
+		}
+	}
+
+	std::cout << "total: " << total.nodes << " nodes, " << total.elapsed << " ms, " << total.nodes_per_second() << " nodes/s" << std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "Board.hpp"
+#include "Game.hpp"
+
+/**
+Perft: move generation benchmark and correctness check
+
+Counts the leaves of the game tree to a fixed depth. A pass is a move (it uses one ply)
+and a finished game is a leaf, which gives the usual Othello perft numbers from the
+initial position: 4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284, ...
+
+Positions file: one position per line, 64 cells from a1 to h8 ('X' / '*' black,
+'O' white, '-' / '.' empty) followed by the side to move ('X' or 'O').
+Anything after that on the line is ignored, as are empty lines and lines starting with '#'.
+
+Kernel check: every move kernel is compared with the reference kernels below, the original
+direction-by-direction loops, on every empty cell of random games and of random bitboards.
+*/
+
+class PerftTable {
+private:
+	struct Entry {
+		BitBoard self = 0x0LL;
+		BitBoard opponent = 0x0LL;
+		long long count = 0;
+		int depth = 0;
+	};
+
+	std::vector<Entry> entries;
+	size_t mask = 0;
+
+	size_t index(const Board& board) const {
+		const BitBoard key = board.get_self() * 0x9e3779b97f4a7c15ULL ^ board.get_opponent() * 0xc2b2ae3d27d4eb4fULL;
+		return (size_t)(key ^ (key >> 29)) & mask;
+	}
+
+public:
+	PerftTable() = default;
+
+	PerftTable(const size_t size_mb) {
+		size_t n = 1;
+		while (2 * n * sizeof(Entry) <= size_mb * 1024 * 1024) n *= 2;
+		entries.resize(n);
+		mask = n - 1;
+	}
+
+	bool enabled() const { return !entries.empty(); }
+
+	bool probe(const Board& board, const int depth, long long& count) const {
+		const Entry& entry = entries[index(board)];
+		if (entry.depth == depth && entry.self == board.get_self() && entry.opponent == board.get_opponent()) {
+			count = entry.count;
+			return true;
+		}
+		return false;
+	}
+
+	void store(const Board& board, const int depth, const long long count) {
+		Entry& entry = entries[index(board)];
+		entry.self = board.get_self();
+		entry.opponent = board.get_opponent();
+		entry.count = count;
+		entry.depth = depth;
+	}
+};
+
+long long perft(const Board& board, const int depth, PerftTable& table) {
+	const BitBoard candidates = board.get_candidates();
+
+	if (is_empty(candidates)) {
+		const Board next = board.pass();
+		if (!next.has_candidate()) return 1;
+		return (depth == 1) ? 1 : perft(next, depth - 1, table);
+	}
+	if (depth == 1) return count_stones(candidates);
+
+	long long count = 0;
+	if (table.enabled() && table.probe(board, depth, count)) return count;
+
+	for (const auto& cell : all_cells(candidates)) {
+		count += perft(board.play(cell), depth - 1, table);
+	}
+
+	if (table.enabled()) table.store(board, depth, count);
+	return count;
+}
+
+struct PerftResult {
+	long long nodes = 0;
+	double elapsed = 0;	// ms
+
+	long long nodes_per_second() const {
+		return (elapsed > 0.0) ? (long long)(nodes * 1000.0 / elapsed) : 0;
+	}
+};
+
+// Splits the root moves over `num_threads` threads, each with its own `hash_mb` MB table.
+PerftResult run_perft(const Board& board, const int depth, const int num_threads = 1, const size_t hash_mb = 0) {
+	PerftResult result;
+	const auto start = std::chrono::steady_clock::now();
+
+	if (depth <= 0) {
+		result.nodes = 1;
+	}
+	else if (num_threads <= 1 || depth == 1 || !board.has_candidate()) {
+		PerftTable table(hash_mb);
+		result.nodes = perft(board, depth, table);
+	}
+	else {
+		std::vector<Board> children;
+		for (const auto& cell : board.get_candidate_list()) {
+			children.push_back(board.play(cell));
+		}
+
+		std::atomic<size_t> next{ 0 };
+		std::atomic<long long> nodes{ 0 };
+		std::vector<std::thread> threads;
+		for (int id = 0; id < num_threads; ++id) {
+			threads.push_back(std::thread([&]() {
+				PerftTable table(hash_mb);
+				for (size_t idx = next++; idx < children.size(); idx = next++) {
+					nodes += perft(children[idx], depth - 1, table);
+				}
+			}));
+		}
+		for (auto& thd : threads) {
+			thd.join();
+		}
+		result.nodes = nodes;
+	}
+
+	const auto end = std::chrono::steady_clock::now();
+	result.elapsed = std::chrono::duration<double, std::milli>(end - start).count();
+	return result;
+}
+
+// Parses one line of a positions file, returns false if the line holds no position.
+bool parse_position(const std::string& line, Board& board) {
+	std::istringstream is(line);
+	std::string cells, side;
+	if (!(is >> cells) || cells[0] == '#') return false;
+	if (cells.length() != BOARD_AREA || !(is >> side)) {
+		throw std::invalid_argument("invalid position: " + line);
+	}
+
+	BitBoard black = 0x0LL, white = 0x0LL;
+	for (int n = 0; n < BOARD_AREA; ++n) {
+		const char c = cells[n];
+		if (c == 'X' || c == 'x' || c == '*') black |= 0x1ULL << n;
+		else if (c == 'O' || c == 'o') white |= 0x1ULL << n;
+		else if (c != '-' && c != '.') throw std::invalid_argument("invalid position: " + line);
+	}
+
+	if (side[0] == 'X' || side[0] == 'x' || side[0] == '*') board = Board(black, white);
+	else if (side[0] == 'O' || side[0] == 'o') board = Board(white, black);
+	else throw std::invalid_argument("invalid position: " + line);
+	return true;
+}
+
+std::vector<Board> read_positions(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) throw std::runtime_error("cannot open positions file: " + path);
+
+	std::vector<Board> boards;
+	std::string line;
+	Board board;
+	while (std::getline(file, line)) {
+		if (parse_position(line, board)) boards.push_back(board);
+	}
+	return boards;
+}
+
+// Reference kernels: one direction at a time, one cell at a time.
+BitBoard reference_candidates(const BitBoard& self, const BitBoard& opponent) {
+	BitBoard candidates = 0x0LL;
+
+	BitBoard empty = ~(self | opponent);
+
+	for (auto dir : ALL_DIRS) {
+		BitBoard shifted = self;
+		while (!is_empty(shifted)) {
+			shifted = translate(shifted, dir) & opponent;
+			candidates |= translate(shifted, dir) & empty;
+		}
+	}
+
+	return candidates;
+}
+
+BitBoard reference_flipped(const BitBoard& self, const BitBoard& opponent, const BitBoard& move) {
+	BitBoard flipped = 0x0LL;
+	for (auto dir : ALL_DIRS) {
+		BitBoard captured = 0x0LL;
+		BitBoard shifted = translate(move, dir);
+		while (!is_empty(shifted & opponent)) {
+			shifted &= opponent;
+			captured |= shifted;
+			shifted = translate(shifted, dir);
+		}
+		if (!is_empty(shifted & self)) {
+			flipped |= captured;
+		}
+	}
+	return flipped;
+}
+
+struct KernelCheck {
+	long long positions = 0;
+	long long moves = 0;		// empty cells played, legal or not
+	long long mismatches = 0;
+};
+
+// Compares `kernel` with the reference kernels on one position: the candidates, the flips of
+// every empty cell, and the children of the candidates.
+void check_position(const MoveKernel& kernel, const BitBoard& self, const BitBoard& opponent, KernelCheck& out) {
+	out.positions++;
+	const BitBoard candidates = reference_candidates(self, opponent);
+	if (kernel.candidates(self, opponent) != candidates) out.mismatches++;
+
+	for (BitBoard rest = ~(self | opponent); !is_empty(rest); rest &= rest - 1) {
+		const BitBoard move = rest & (~rest + 1);
+		out.moves++;
+		if (kernel.flipped(self, opponent, move) != reference_flipped(self, opponent, move)) out.mismatches++;
+	}
+
+	ChildBatch batch;
+	kernel.children(self, opponent, candidates, batch);
+	if (batch.size != count_stones(candidates)) out.mismatches++;
+	for (int idx = 0; idx < batch.size; ++idx) {
+		const BitBoard move = batch.move[idx];
+		const BitBoard flipped = reference_flipped(self, opponent, move);
+		if (is_empty(move & candidates) || batch.flipped[idx] != flipped
+			|| batch.candidates[idx] != reference_candidates(opponent ^ flipped, self | move | flipped)) out.mismatches++;
+	}
+}
+
+// Runs the check of `kernel` on every position of `games` random games and on as many random
+// bitboards, reproducible from `seed`.
+KernelCheck check_kernel(const MoveKernel& kernel, const int games, const unsigned int seed) {
+	std::mt19937_64 engine(seed);
+	KernelCheck out;
+	for (int game = 0; game < games; ++game) {
+		Board board(init_black, init_white);
+		while (!board.finished()) {
+			check_position(kernel, board.get_self(), board.get_opponent(), out);
+			const auto candidates = board.get_candidate_list();
+			board = candidates.empty() ? board.pass() : board.play(candidates.at((size_t)(engine() % candidates.size())));
+		}
+		check_position(kernel, board.get_self(), board.get_opponent(), out);
+	}
+	for (int idx = 0; idx < games; ++idx) {
+		// about a third of the cells each, empty for the rest
+		const BitBoard self = engine() & engine();
+		const BitBoard opponent = engine() & engine() & ~self;
+		check_position(kernel, self, opponent, out);
+	}
+	return out;
+}
\ No newline at end of file
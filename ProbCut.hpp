@@ -0,0 +1,146 @@
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "BitBoard.hpp"
+
+/**
+Multi-ProbCut parameters
+
+The value of a deep search is predicted from the value of a shallow search of the same position by
+a linear regression, deep = a * shallow + b, with a normal error of deviation sigma. A node of
+depth `deep` whose shallow search predicts a value beyond beta (or below alpha) by more than
+`threshold` deviations is cut without the deep search.
+
+There is one regression per side, game phase, depth and check: each check is a shallow search
+`reduction(check)` plies less deep, the cheaper ones first. The values are from the side of the AI
+at every node and its evaluation is not antisymmetric, so the nodes where the AI is to move and
+those where its opponent is have regressions of their own. Nodes deeper than the deepest fitted
+depth use its regressions with the same depth differences.
+
+The depths are whole plies: a node of fractional depth uses the regression of the whole depth
+below it, and searches its shallow value that many plies less deep, as the regression was fitted.
+
+The parameters depend on the evaluation function; they are fitted by the ProbCutFit tool, and a
+search without them does not prune.
+*/
+
+struct ProbCutRegression {
+	double a = 1.0;
+	double b = 0.0;
+	double sigma = 0.0;
+	int samples = 0;	// 0: not fitted
+
+	bool fitted() const { return samples > 0; }
+};
+
+class ProbCut {
+public:
+	static constexpr int NUM_PHASES = 6;	// empties 0-9, 10-19, ..., 50-60
+	static constexpr int MIN_DEPTH = 4;		// shallower nodes are not worth a check
+	static constexpr int MAX_DEPTH = 8;
+	static constexpr int NUM_CHECKS = 2;
+
+	// Values this large are proven wins or losses, not estimates, and are never predicted.
+	static constexpr double MAX_VALUE = 40000.0;
+
+	static int phase_of(const int empties) {
+		return std::min(empties / 10, NUM_PHASES - 1);
+	}
+
+	// Whole plies of a fractional depth, a sum of reductions which may fall just short.
+	static int whole_depth(const double depth) {
+		return (int)std::floor(depth + 1e-6);
+	}
+
+	// Depth difference of the shallow search of the check, 6 then 4: the cheaper check comes first.
+	// Shallow searches only 2 plies less deep cost more than the nodes they cut.
+	static int reduction(const int check) {
+		return 2 * (NUM_CHECKS - check) + 2;
+	}
+
+	// Depth of the shallow search of the check at a node with `depth` left.
+	static int shallow_depth(const double depth, const int check) {
+		return whole_depth(depth) - reduction(check);
+	}
+
+private:
+	ProbCutRegression regressions[2][NUM_PHASES][MAX_DEPTH + 1][NUM_CHECKS];	// [is_myturn]
+	bool loaded = false;
+
+public:
+	double threshold = 1.5;	// in deviations
+
+	bool enabled() const { return loaded; }
+
+	void disable() { loaded = false; }
+
+	ProbCutRegression& at(const bool is_myturn, const int phase, const int depth, const int check) {
+		return regressions[is_myturn][phase][depth][check];
+	}
+
+	const ProbCutRegression& at(const bool is_myturn, const int phase, const int depth, const int check) const {
+		return regressions[is_myturn][phase][depth][check];
+	}
+
+	// Regression of the check for a node with `empties` empty cells and `depth` left: the one of
+	// the deepest fitted whole depth up to `depth`, if any.
+	const ProbCutRegression* find(const bool is_myturn, const int empties, const double depth, const int check) const {
+		const int whole = whole_depth(depth);
+		if (whole < MIN_DEPTH) return nullptr;
+		const int phase = phase_of(empties);
+		for (int deep = std::min(whole, (int)MAX_DEPTH); deep >= MIN_DEPTH && deep >= reduction(check); --deep) {
+			const ProbCutRegression& regression = regressions[is_myturn][phase][deep][check];
+			if (regression.fitted()) return &regression;
+		}
+		return nullptr;
+	}
+
+	// One line per fitted regression: is_myturn (0 or 1), phase, depth, check, a, b, sigma and
+	// samples.
+	bool save(const std::string& path) const {
+		std::ofstream file(path);
+		if (!file) return false;
+		file.precision(10);
+		for (int side = 0; side < 2; ++side) {
+			for (int phase = 0; phase < NUM_PHASES; ++phase) {
+				for (int depth = 0; depth <= MAX_DEPTH; ++depth) {
+					for (int check = 0; check < NUM_CHECKS; ++check) {
+						const ProbCutRegression& r = regressions[side][phase][depth][check];
+						if (!r.fitted()) continue;
+						file << side << " " << phase << " " << depth << " " << check << " " << r.a << " " << r.b << " " << r.sigma << " "
+							<< r.samples << "\n";
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	// False, and no pruning, if the file cannot be read. Lines of another layout, e.g. without the
+	// side, are skipped: such a file is fitted again.
+	bool load(const std::string& path) {
+		const double threshold_ = threshold;
+		*this = ProbCut();
+		threshold = threshold_;
+		std::ifstream file(path);
+		if (!file) return false;
+
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream fields(line);
+			int side, phase, depth, check;
+			ProbCutRegression r;
+			std::string rest;
+			if (!(fields >> side >> phase >> depth >> check >> r.a >> r.b >> r.sigma >> r.samples) || (fields >> rest)) continue;
+			if (side < 0 || side > 1 || phase < 0 || phase >= NUM_PHASES || depth < 0 || depth > MAX_DEPTH || check < 0 || check >= NUM_CHECKS) continue;
+			regressions[side][phase][depth][check] = r;
+			loaded = true;
+		}
+		return loaded;
+	}
+};
@@ -0,0 +1,98 @@
+#include <iostream>
+
+#include "ProbCutFit.hpp"
+#include "DLAlphaBetaAI.hpp"
+
+void print_usage() {
+	std::cout << "usage: ProbCutFit [-a dl|hand] [-d depth] [-n positions] [-k stride] [-s seed] [-o output] [wthor files...]\n"
+		<< "  Fits the Multi-ProbCut regressions of an AI on positions of WTHOR games.\n"
+		<< "  -a  evaluation: dl (DLAlphaBetaAI, default) or hand (AlphaBetaAI)\n"
+		<< "  -d  deepest fitted depth (default 6, at most " << ProbCut::MAX_DEPTH << ")\n"
+		<< "  -n  positions (default 2000)\n"
+		<< "  -k  plies between two positions of a game (default 6)\n"
+		<< "  -s  random seed (default 1)\n"
+		<< "  -o  output (default data\\probcut\\<evaluation>.txt)\n"
+		<< "  files default to data\\original\\WTH_2003.wtb ... WTH_2023.wtb\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::string evaluation = "dl";
+	int max_depth = 6;
+	size_t max_positions = 2000;
+	int stride = 6;
+	unsigned int seed = 1;
+	std::string output;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "-a" && has_value) evaluation = argv[++i];
+		else if (arg == "-d" && has_value) max_depth = std::stoi(argv[++i]);
+		else if (arg == "-n" && has_value) max_positions = (size_t)std::stoul(argv[++i]);
+		else if (arg == "-k" && has_value) stride = std::stoi(argv[++i]);
+		else if (arg == "-s" && has_value) seed = (unsigned int)std::stoul(argv[++i]);
+		else if (arg == "-o" && has_value) output = argv[++i];
+		else if (!arg.empty() && arg[0] != '-') files.push_back(arg);
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+	if ((evaluation != "dl" && evaluation != "hand") || max_depth < ProbCut::MIN_DEPTH || max_depth > ProbCut::MAX_DEPTH || stride < 1) {
+		print_usage();
+		return 1;
+	}
+	if (output.empty()) output = "data\\probcut\\" + evaluation + ".txt";
+	if (files.empty()) {
+		for (int year = 2003; year <= 2023; ++year) {
+			files.push_back("data\\original\\WTH_" + std::to_string(year) + ".wtb");
+		}
+	}
+
+	std::vector<std::vector<Board>> games;
+	for (const auto& file : files) {
+		const auto file_games = read_wthor_games(file);
+		if (file_games.empty()) std::cout << file << ": no game" << std::endl;
+		games.insert(games.end(), file_games.begin(), file_games.end());
+	}
+
+	// the endgame solver takes over below
+	constexpr int MIN_EMPTIES = 20;
+	const auto positions = sample_positions(games, MIN_EMPTIES, stride, max_positions, seed);
+	std::cout << games.size() << " games, " << positions.size() << " positions" << std::endl;
+	if (positions.empty()) return 1;
+
+	std::unique_ptr<AlphaBetaAI> ai;
+	if (evaluation == "dl") ai = std::make_unique<DLAlphaBetaAI>();
+	else ai = std::make_unique<AlphaBetaAI>();
+	ai->disable_probcut();
+
+	std::vector<ProbCutSample> samples;
+	for (const auto& board : positions) {
+		samples.push_back(sample_values(*ai, board, max_depth));
+		if (samples.size() % 100 == 0) std::cout << samples.size() << " positions searched" << std::endl;
+	}
+
+	const ProbCut probcut = fit_probcut(samples);
+	std::cout << "to move, phase, depth, shallow: a b sigma (samples)" << std::endl;
+	for (int side = 0; side < 2; ++side) {
+		for (int phase = 0; phase < ProbCut::NUM_PHASES; ++phase) {
+			for (int deep = ProbCut::MIN_DEPTH; deep <= max_depth; ++deep) {
+				for (int check = 0; check < ProbCut::NUM_CHECKS; ++check) {
+					const ProbCutRegression& r = probcut.at(side == 1, phase, deep, check);
+					if (!r.fitted()) continue;
+					std::cout << ((side == 1) ? "ai " : "opponent ") << phase << " " << deep << " " << deep - ProbCut::reduction(check) << ": "
+						<< r.a << " " << r.b << " " << r.sigma << " (" << r.samples << ")" << std::endl;
+				}
+			}
+		}
+	}
+
+	if (!probcut.save(output)) {
+		std::cout << "cannot write " << output << std::endl;
+		return 1;
+	}
+	std::cout << "saved to " << output << std::endl;
+}
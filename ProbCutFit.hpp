@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "AlphaBetaAI.hpp"
+#include "ProbCut.hpp"
+#include "reader.hpp"
+
+/**
+Fitting of the Multi-ProbCut parameters
+
+Positions are sampled from the games of WTHOR files. Each one is searched with the full window at
+every depth from 0 (the evaluation itself) to the deepest fitted one, by the AI whose evaluation
+the parameters are for, with its pruning off, once with the AI to move and once with its opponent
+to move. Then for each side, phase, depth and check the deep values are regressed on the shallow
+ones by least squares, sigma being the deviation of the residuals.
+
+Proven wins and losses (beyond ProbCut::MAX_VALUE) are left out: they are not estimates, and the
+endgame solver takes over before they are common.
+*/
+
+struct ProbCutSample {
+	int empties = 0;
+	std::vector<double> values[2];	// [is_myturn][depth]
+};
+
+// Up to `max_positions` positions of `games` with more than `min_empties` empty cells, one every
+// `stride` plies from a random ply of each game, reproducible from `seed`.
+std::vector<Board> sample_positions(const std::vector<std::vector<Board>>& games, const int min_empties, const int stride,
+	const size_t max_positions, const unsigned int seed) {
+	std::mt19937 engine(seed);
+	std::vector<Board> out;
+	for (const auto& game : games) {
+		for (size_t ply = engine() % stride; ply < game.size() && out.size() < max_positions; ply += stride) {
+			const Board& board = game[ply];
+			if (count_stones(~(board.get_self() | board.get_opponent())) > min_empties && !board.finished()) out.push_back(board);
+		}
+	}
+	return out;
+}
+
+ProbCutSample sample_values(AlphaBetaAI& ai, const Board& board, const int max_depth) {
+	ProbCutSample sample;
+	sample.empties = count_stones(~(board.get_self() | board.get_opponent()));
+	for (int side = 0; side < 2; ++side) {
+		ai.clear();
+		for (int depth = 0; depth <= max_depth; ++depth) {
+			sample.values[side].push_back(ai.search_value(board, depth, side == 1));
+		}
+	}
+	return sample;
+}
+
+// Least squares of the deep values on the shallow ones of the samples of one side and phase;
+// unfitted with fewer than `min_samples` samples.
+ProbCutRegression fit_regression(const std::vector<ProbCutSample>& samples, const bool is_myturn, const int phase,
+	const int deep, const int shallow, const int min_samples) {
+	int n = 0;
+	double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0, sum_yy = 0;
+	for (const auto& sample : samples) {
+		const std::vector<double>& values = sample.values[is_myturn];
+		if (ProbCut::phase_of(sample.empties) != phase || (int)values.size() <= deep) continue;
+		const double x = values[shallow], y = values[deep];
+		if (std::fabs(x) >= ProbCut::MAX_VALUE || std::fabs(y) >= ProbCut::MAX_VALUE) continue;
+		n++;
+		sum_x += x;
+		sum_y += y;
+		sum_xx += x * x;
+		sum_xy += x * y;
+		sum_yy += y * y;
+	}
+	ProbCutRegression r;
+	const double var_x = sum_xx / n - (sum_x / n) * (sum_x / n);
+	if (n < min_samples || var_x <= 0) return r;
+
+	const double cov = sum_xy / n - (sum_x / n) * (sum_y / n);
+	const double var_y = sum_yy / n - (sum_y / n) * (sum_y / n);
+	r.a = cov / var_x;
+	r.b = sum_y / n - r.a * sum_x / n;
+	r.sigma = std::sqrt(std::max(0.0, var_y - r.a * cov));
+	r.samples = n;
+	return r;
+}
+
+// Regressions with fewer than `min_samples` samples are left unfitted.
+ProbCut fit_probcut(const std::vector<ProbCutSample>& samples, const int min_samples = 30) {
+	ProbCut out;
+	for (int side = 0; side < 2; ++side) {
+		for (int phase = 0; phase < ProbCut::NUM_PHASES; ++phase) {
+			for (int deep = ProbCut::MIN_DEPTH; deep <= ProbCut::MAX_DEPTH; ++deep) {
+				for (int check = 0; check < ProbCut::NUM_CHECKS; ++check) {
+					const int shallow = deep - ProbCut::reduction(check);
+					if (shallow < 0) continue;
+					out.at(side == 1, phase, deep, check) = fit_regression(samples, side == 1, phase, deep, shallow, min_samples);
+				}
+			}
+		}
+	}
+	return out;
+}
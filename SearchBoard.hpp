@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+
+#include "Board.hpp"
+#include "Zobrist.hpp"
+
+/**
+Mutable position for the search engines
+
+A Board is an immutable position and recomputes its candidates on every query. During a
+search the same position is instead played forward with do_move() and taken back with
+undo_move(), using the flip mask of each move, so no Board is constructed per node.
+
+Candidates are computed lazily and cached per ply: a leaf which is only evaluated never
+pays for move generation, and a parent keeps its candidates while its children are searched.
+The Zobrist key is cached per ply in the same way: it is only brought up to date, from the
+last ply which has it, when a search asks for it.
+*/
+
+// A move together with everything the search already knows about it.
+struct SearchMove {
+	BitBoard move = 0x0LL;
+	BitBoard flipped = 0x0LL;
+	BitBoard candidates = 0x0LL;	// candidates of the position after the move
+	int score = 0;					// move ordering score
+
+	bool is_pass() const { return is_empty(move); }
+
+	Cell to_cell() const { return is_pass() ? Cell::Pass() : Cell(move); }
+};
+
+// The children of one node. The buffer has a fixed capacity and lives on the stack of the
+// search function, so generating children never allocates.
+class ChildList {
+private:
+	SearchMove children[ChildBatch::CAPACITY];
+	int count = 0;
+
+public:
+	SearchMove* begin() { return children; }
+	SearchMove* end() { return children + count; }
+	const SearchMove* begin() const { return children; }
+	const SearchMove* end() const { return children + count; }
+
+	size_t size() const { return (size_t)count; }
+
+	bool empty() const { return count == 0; }
+
+	SearchMove& at(const size_t idx) { return children[idx]; }
+	const SearchMove& at(const size_t idx) const { return children[idx]; }
+
+	void clear() { count = 0; }
+
+	void push_back(const SearchMove& child) { children[count++] = child; }
+
+	void sort_by_score() {
+		std::sort(begin(), end(),
+			[](const SearchMove& a, const SearchMove& b) {
+				return a.score > b.score;
+			});
+	}
+};
+
+class SearchBoard {
+private:
+	// a game has at most 60 moves and a pass never follows a pass, hence 2 * 60 plies.
+	static constexpr int MAX_PLY = 2 * BOARD_AREA;
+
+	// Left uninitialized until played: a SearchBoard only writes the plies it reaches.
+	struct Ply {
+		BitBoard move;
+		BitBoard flipped;
+		BitBoard candidates;
+		ZobristKey key;
+		bool has_candidates;
+		bool has_key;
+	};
+
+	BitBoard self = 0x0LL;
+	BitBoard opponent = 0x0LL;
+	int ply = 0;		// index in `history`
+	int first_ply = 0;	// ply of history[0] from the root of the search
+	Ply history[MAX_PLY + 1];
+
+	BitBoard candidates_at(const int idx, const BitBoard& self_, const BitBoard& opponent_) {
+		Ply& entry = history[idx];
+		if (!entry.has_candidates) {
+			entry.candidates = move_kernel.candidates(self_, opponent_);
+			entry.has_candidates = true;
+		}
+		return entry.candidates;
+	}
+
+	// Position at ply `idx`, the moves after it taken back.
+	Board board_at(const int idx) const {
+		BitBoard self_ = self, opponent_ = opponent;
+		for (int back = ply; back > idx; --back) {
+			const Ply& last = history[back];
+			const BitBoard prev_self = opponent_ ^ last.move ^ last.flipped;
+			opponent_ = self_ ^ last.flipped;
+			self_ = prev_self;
+		}
+		return Board(self_, opponent_);
+	}
+
+	// The first ply of a copy from another SearchBoard may have no key yet, then hashed in full.
+	const ZobristKey& key_at(const int idx) {
+		Ply& entry = history[idx];
+		if (!entry.has_key) {
+			entry.key = (idx == 0) ? ZobristKey(board_at(0)) : key_at(idx - 1).play(entry.move, entry.flipped);
+			entry.has_key = true;
+		}
+		return entry.key;
+	}
+
+public:
+	SearchBoard() : SearchBoard(Board()) {};
+
+	SearchBoard(const Board& board) : self(board.get_self()), opponent(board.get_opponent()) {
+		Ply& root = history[0];
+		root.move = 0x0LL;
+		root.flipped = 0x0LL;
+		root.has_candidates = false;
+		root.key = ZobristKey(board);
+		root.has_key = true;
+	};
+
+	// Tag of the constructor copying only the current ply of a SearchBoard.
+	struct CurrentPly {};
+
+	// The current position of `board` for another thread to search from, e.g. a child of a split
+	// node: only the current ply is copied, and the moves before it cannot be taken back. The plies
+	// still count from the root of the search. `board` is only read, so that threads may share it.
+	SearchBoard(const SearchBoard& board, CurrentPly)
+		: self(board.self), opponent(board.opponent), first_ply(board.get_ply()) {
+		history[0] = board.history[board.ply];
+	};
+
+	Board to_board() const { return Board(self, opponent); }
+
+	BitBoard get_self() const { return self; }
+
+	BitBoard get_opponent() const { return opponent; }
+
+	// Plies played from the root of the search.
+	int get_ply() const { return first_ply + ply; }
+
+	// Zobrist hash of the position, updated by every move and pass.
+	BitBoard get_hash() { return key_at(ply).key; }
+
+	BitBoard get_candidates() {
+		return candidates_at(ply, self, opponent);
+	}
+
+	// Candidates of the player who made the last move, i.e. of the previous position.
+	BitBoard get_prev_candidates() {
+		if (ply == 0) return move_kernel.candidates(opponent, self);
+		const Ply& last = history[ply];
+		return candidates_at(ply - 1, opponent ^ last.move ^ last.flipped, self ^ last.flipped);
+	}
+
+	// Stones changed by the last move: the placed stone and the flipped stones.
+	BitBoard get_last_played() const {
+		return history[ply].move | history[ply].flipped;
+	}
+
+	bool has_candidate() { return !is_empty(get_candidates()); }
+
+	bool finished() {
+		if (has_candidate()) return false;
+		return is_empty(move_kernel.candidates(opponent, self));
+	}
+
+	SearchMove make_move(const BitBoard& move) const {
+		SearchMove out;
+		out.move = move;
+		out.flipped = is_empty(move) ? 0x0LL : move_kernel.flipped(self, opponent, move);
+		return out;
+	}
+
+	// Fills `children` with every child of the position (a single pass if there is no move),
+	// their flip masks and candidates computed in one batch.
+	void generate_children(ChildList& children) {
+		children.clear();
+		const BitBoard candidates = get_candidates();
+
+		if (is_empty(candidates)) {
+			SearchMove pass;
+			pass.candidates = move_kernel.candidates(opponent, self);
+			children.push_back(pass);
+			return;
+		}
+
+		ChildBatch batch;
+		move_kernel.children(self, opponent, candidates, batch);
+		for (int idx = 0; idx < batch.size; ++idx) {
+			SearchMove child;
+			child.move = batch.move[idx];
+			child.flipped = batch.flipped[idx];
+			child.candidates = batch.candidates[idx];
+			children.push_back(child);
+		}
+	}
+
+	void do_move(const SearchMove& move) {
+		const BitBoard next_self = opponent ^ move.flipped;
+		opponent = self | move.move | move.flipped;
+		self = next_self;
+		Ply& entry = history[++ply];
+		entry.move = move.move;
+		entry.flipped = move.flipped;
+		entry.has_candidates = false;
+		entry.has_key = false;
+	}
+
+	// Plays a move whose child candidates were already computed, e.g. for move ordering.
+	void do_move_with_candidates(const SearchMove& move) {
+		do_move(move);
+		history[ply].candidates = move.candidates;
+		history[ply].has_candidates = true;
+	}
+
+	void do_move(const BitBoard& move) {
+		do_move(make_move(move));
+	}
+
+	void do_pass() {
+		do_move(SearchMove());
+	}
+
+	void undo_move() {
+		const Ply& last = history[ply--];
+		const BitBoard prev_self = opponent ^ last.move ^ last.flipped;
+		opponent = self ^ last.flipped;
+		self = prev_self;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "BitBoard.hpp"
+
+/**
+Stable stones
+
+A stone is stable if no sequence of moves can flip it.
+
+Edges: a stone on an edge can only be flipped along that edge, so its stability depends on the
+8 cells of the edge alone. It is looked up in a table over all 3^8 edge configurations, solved
+once at startup by playing every move of either colour on the edge.
+
+Interior: a stone is stable if along each of the four lines either the line is full or one of its
+two neighbours on the line is a stable stone of the same colour. Starting from the edge stones and
+the stones whose four lines are all full, the rule is applied until no stone is added.
+
+With few empty cells, most interior stones have four full lines and the rule adds few stones at
+the cost of many passes: there only the edge stones and the full lines are counted, still a sound
+if smaller set.
+*/
+
+class EdgeStability {
+private:
+	static constexpr int NUM_CONFIGS = 6561;	// 3^8
+	static constexpr BitBoard COLUMN_A = 0x0101010101010101LL;
+	static constexpr BitBoard COLUMN_TO_ROW = 0x0102040810204080LL;
+
+	unsigned char stable[NUM_CONFIGS];
+	unsigned short ternary[256];
+	BitBoard column[256];	// row bits of a byte spread over column a
+
+	int index(const unsigned char& self, const unsigned char& opponent) const {
+		return ternary[self] + 2 * ternary[opponent];
+	}
+
+	// Stones of `opponent` flipped on a single line when `self` plays `move`.
+	static unsigned char flipped(const unsigned char& self, const unsigned char& opponent, const unsigned char& move) {
+		unsigned char out = 0;
+
+		unsigned int line = 0;
+		unsigned int cell = (unsigned int)move << 1;
+		for (; cell & opponent; cell <<= 1) line |= cell;
+		if (cell & self) out |= (unsigned char)line;
+
+		line = 0;
+		cell = (unsigned int)move >> 1;
+		for (; cell & opponent; cell >>= 1) line |= cell;
+		if (cell & self) out |= (unsigned char)line;
+
+		return out;
+	}
+
+	unsigned char solve(const unsigned char& self, const unsigned char& opponent, std::vector<bool>& solved) {
+		const int idx = index(self, opponent);
+		if (solved[idx]) return stable[idx];
+
+		unsigned char result = self | opponent;
+		const unsigned char empty = (unsigned char)~(self | opponent);
+		for (unsigned int rest = empty; rest != 0 && result != 0; rest &= rest - 1) {
+			const unsigned char move = (unsigned char)(rest & (~rest + 1));
+
+			const unsigned char self_flipped = flipped(self, opponent, move);
+			result &= ~self_flipped & solve(self | move | self_flipped, opponent & ~self_flipped, solved);
+
+			const unsigned char opponent_flipped = flipped(opponent, self, move);
+			result &= ~opponent_flipped & solve(self & ~opponent_flipped, opponent | move | opponent_flipped, solved);
+		}
+
+		stable[idx] = result;
+		solved[idx] = true;
+		return result;
+	}
+
+	static unsigned char column_to_row(const BitBoard& board) {
+		return (unsigned char)(((board & COLUMN_A) * COLUMN_TO_ROW) >> 56);
+	}
+
+public:
+	EdgeStability() {
+		for (int bits = 0; bits < 256; ++bits) {
+			ternary[bits] = 0;
+			column[bits] = 0x0LL;
+			for (int n = BOARD_SIZE - 1; n >= 0; --n) {
+				ternary[bits] = ternary[bits] * 3 + ((bits >> n) & 1);
+				if ((bits >> n) & 1) column[bits] |= 0x1ULL << (n * BOARD_SIZE);
+			}
+		}
+
+		std::vector<bool> solved(NUM_CONFIGS, false);
+		for (int self = 0; self < 256; ++self) {
+			for (int opponent = 0; opponent < 256; ++opponent) {
+				if ((self & opponent) == 0) solve((unsigned char)self, (unsigned char)opponent, solved);
+			}
+		}
+	}
+
+	// Stable stones of either colour on the four edges.
+	BitBoard edges(const BitBoard& self, const BitBoard& opponent) const {
+		const BitBoard top = stable[index((unsigned char)self, (unsigned char)opponent)];
+		const BitBoard bottom = stable[index((unsigned char)(self >> 56), (unsigned char)(opponent >> 56))];
+		const BitBoard left = column[stable[index(column_to_row(self), column_to_row(opponent))]];
+		const BitBoard right = column[stable[index(column_to_row(self >> 7), column_to_row(opponent >> 7))]];
+		return top | (bottom << 56) | left | (right << 7);
+	}
+};
+
+static const EdgeStability edge_stability;
+
+constexpr BitBoard INTERIOR_MASK = 0x007e7e7e7e7e7e00LL;
+
+// fewer empty cells: no propagation
+constexpr int PROPAGATION_MIN_EMPTIES = 10;
+
+// Moves every cell S steps towards the lower bits (S > 0) or -S steps towards the higher bits.
+template <int S>
+inline BitBoard step_back(const BitBoard& board) {
+	return (S > 0) ? (board >> (S > 0 ? S : 0)) : (board << (S < 0 ? -S : 0));
+}
+
+// Cells of `occupied` from which every cell S, 2S, ... bits away is occupied up to the edge.
+// `off_n` marks the cells from which n steps of S leave the board.
+template <int S>
+inline BitBoard full_towards(BitBoard line, const BitBoard& off_1, const BitBoard& off_2, const BitBoard& off_4) {
+	line &= step_back<S>(line) | off_1;
+	line &= step_back<2 * S>(line) | off_2;
+	line &= step_back<4 * S>(line) | off_4;
+	return line;
+}
+
+// Cells of `occupied` whose row is full.
+inline BitBoard full_horizontal(const BitBoard& occupied) {
+	BitBoard row = occupied & (occupied >> 1);
+	row &= row >> 2;
+	row &= row >> 4;
+	return (row & 0x0101010101010101LL) * 0xffLL;
+}
+
+// Cells of `occupied` whose column is full.
+inline BitBoard full_vertical(const BitBoard& occupied) {
+	BitBoard column = occupied & (occupied >> BOARD_SIZE);
+	column &= column >> (2 * BOARD_SIZE);
+	column &= column >> (4 * BOARD_SIZE);
+	return (column & 0xffLL) * 0x0101010101010101LL;
+}
+
+inline BitBoard full_diagonal_7(const BitBoard& occupied) {
+	return full_towards<BOARD_SIZE - 1>(occupied, 0xff01010101010101LL, 0xffff030303030303LL, 0xffffffff0f0f0f0fLL)
+		& full_towards<1 - BOARD_SIZE>(occupied, 0x80808080808080ffLL, 0xc0c0c0c0c0c0ffffLL, 0xf0f0f0f0ffffffffLL);
+}
+
+inline BitBoard full_diagonal_9(const BitBoard& occupied) {
+	return full_towards<BOARD_SIZE + 1>(occupied, 0xff80808080808080LL, 0xffffc0c0c0c0c0c0LL, 0xfffffffff0f0f0f0LL)
+		& full_towards<-BOARD_SIZE - 1>(occupied, 0x01010101010101ffLL, 0x030303030303ffffLL, 0x0f0f0f0fffffffffLL);
+}
+
+// Cells whose line in each direction pair has no empty cell.
+struct FullLines {
+	BitBoard horizontal;
+	BitBoard vertical;
+	BitBoard diagonal_7;
+	BitBoard diagonal_9;
+};
+
+// Cells next to a stable stone (or with a full line) along every one of the four lines.
+inline BitBoard supported(const BitBoard& stable, const FullLines& full) {
+	return (full.horizontal | shift<LEFT>(stable) | shift<RIGHT>(stable))
+		& (full.vertical | shift<UP>(stable) | shift<DOWN>(stable))
+		& (full.diagonal_7 | shift<UP_RIGHT>(stable) | shift<DOWN_LEFT>(stable))
+		& (full.diagonal_9 | shift<UP_LEFT>(stable) | shift<DOWN_RIGHT>(stable));
+}
+
+void calculate_fixed_stones(const BitBoard& self, const BitBoard& opponent, BitBoard& self_fixed, BitBoard& opponent_fixed) {
+	const BitBoard occupied = self | opponent;
+
+	// without a stable edge stone or a cell whose row and column are both full no interior
+	// stone can be stable, and the diagonals are not needed.
+	const BitBoard edges = edge_stability.edges(self, opponent);
+	const BitBoard horizontal = full_horizontal(occupied);
+	const BitBoard vertical = full_vertical(occupied);
+	if (is_empty(edges | (horizontal & vertical))) {
+		self_fixed = opponent_fixed = 0x0LL;
+		return;
+	}
+
+	const FullLines full = { horizontal, vertical, full_diagonal_7(occupied), full_diagonal_9(occupied) };
+	const BitBoard stable = edges | (horizontal & vertical & full.diagonal_7 & full.diagonal_9);
+
+	self_fixed = stable & self;
+	opponent_fixed = stable & opponent;
+	if (is_empty(stable) || count_stones(~occupied) < PROPAGATION_MIN_EMPTIES) return;
+
+	// both colours grow together; a stone is only supported by stable stones of its own colour
+	const BitBoard self_inner = self & INTERIOR_MASK;
+	const BitBoard opponent_inner = opponent & INTERIOR_MASK;
+	while (true) {
+		const BitBoard next = ((self_inner & supported(self_fixed, full)) | (opponent_inner & supported(opponent_fixed, full))) & ~(self_fixed | opponent_fixed);
+		if (is_empty(next)) return;
+		self_fixed |= next & self;
+		opponent_fixed |= next & opponent;
+	}
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#include "BitBoard.hpp"
+
+/**
+Transposition table shared by all search threads
+
+The table is a power of two of buckets, each of 4 entries (64 bytes, aligned on a cache line). An entry
+is two 64-bit words: the packed data and the key XOR the data. Both words are written and read
+with relaxed atomics and no lock; an entry torn by two threads writing at once fails the key
+check on probe and is simply a miss.
+
+Data layout: value (float, 32 bits) | depth * 100 (16) | best move (8) | bound (2) | rounded (1)
+| age (5). A bound is rounded to float towards its safe side; an exact value cannot be, so it is
+flagged when rounded and then only known to within one float of it. The depth is rounded to the
+nearest centi-ply: the fractional depths of the search are sums of reductions, a little off. The
+age is the search generation which wrote the entry, so entries from earlier moves of the game can
+be kept and still be replaced first.
+*/
+
+constexpr double TABLE_DEPTH_SCALE = 100.0;	// depths are stored in centi-plies
+
+inline int table_depth(const double depth) {
+	return (int)std::max(-32768L, std::min(32767L, std::lround(depth * TABLE_DEPTH_SCALE)));
+}
+
+enum class Bound : unsigned char {
+	NONE = 0,
+	UPPER = 1,	// value >= true value (fail low)
+	LOWER = 2,	// value <= true value (fail high)
+	EXACT = 3
+};
+
+inline Bound bound_of(const double value, const double alpha, const double beta) {
+	if (value <= alpha) return Bound::UPPER;
+	if (value >= beta) return Bound::LOWER;
+	return Bound::EXACT;
+}
+
+enum class Replacement {
+	ALWAYS,		// one slot per key, always overwritten
+	DEPTH,		// the shallowest entry of the bucket is replaced
+	AGE_DEPTH	// entries of earlier searches first, then the shallowest
+};
+
+struct TableEntry {
+	double value = 0;
+	double depth = 0;
+	Bound bound = Bound::NONE;
+	BitBoard move = 0x0LL;	// best move, empty for a pass or if unknown
+	int age = 0;
+	bool rounded = false;	// an EXACT value was not a float
+
+	// The entry was searched at least `depth_` deep, to the precision of the table.
+	bool covers(const double depth_) const {
+		return table_depth(depth) >= table_depth(depth_);
+	}
+
+	// The entry gives the value of a node searched in (alpha, beta): it is exact, or a bound
+	// outside of the window. A rounded exact value must fall on the same side of the window as
+	// the true one, which is between its float neighbours.
+	bool cuts(const double alpha, const double beta) const {
+		switch (bound) {
+		case Bound::LOWER: return value >= beta;
+		case Bound::UPPER: return value <= alpha;
+		case Bound::EXACT: {
+			if (!rounded) return true;
+			const double low = std::nextafter((float)value, -HUGE_VALF), high = std::nextafter((float)value, HUGE_VALF);
+			return low >= beta || high <= alpha || (low > alpha && high < beta);
+		}
+		default: return false;
+		}
+	}
+};
+
+class TranspositionTable {
+private:
+	static constexpr int BUCKET_SIZE = 4;
+	static constexpr int NO_MOVE = BOARD_AREA;
+	static constexpr int AGE_MASK = 0x1f;
+	static constexpr size_t CACHE_LINE = 64;
+
+	struct alignas(CACHE_LINE) Bucket {
+		std::atomic<BitBoard> data[BUCKET_SIZE];
+		std::atomic<BitBoard> check[BUCKET_SIZE];	// key ^ data
+	};
+
+	// the allocator only aligns on 16 bytes before C++17: the buckets are placed by hand
+	std::unique_ptr<char[]> storage;
+	Bucket* buckets = nullptr;
+	size_t num_buckets = 0;
+	size_t mask = 0;
+	Replacement replacement;
+	int age = 0;
+
+	static BitBoard pack(const double value, const double depth, const Bound bound, const BitBoard& move, const int age) {
+		// rounded towards the safe side of the bound
+		float value_f = (float)value;
+		if (bound == Bound::LOWER && value_f > value) value_f = std::nextafter(value_f, -HUGE_VALF);
+		if (bound == Bound::UPPER && value_f < value) value_f = std::nextafter(value_f, HUGE_VALF);
+		const bool rounded = bound == Bound::EXACT && value_f != value;
+		unsigned int value_bits = 0;
+		std::memcpy(&value_bits, &value_f, sizeof(value_bits));
+		const int move_loc = is_empty(move) ? NO_MOVE : lsb_loc(move);
+		return (BitBoard)value_bits
+			| ((BitBoard)(unsigned short)table_depth(depth) << 32)
+			| ((BitBoard)move_loc << 48)
+			| ((BitBoard)bound << 56)
+			| ((BitBoard)rounded << 58)
+			| ((BitBoard)(age & AGE_MASK) << 59);
+	}
+
+	static TableEntry unpack(const BitBoard& data) {
+		TableEntry entry;
+		const unsigned int value_bits = (unsigned int)data;
+		float value_f = 0;
+		std::memcpy(&value_f, &value_bits, sizeof(value_f));
+		entry.value = value_f;
+		entry.depth = (short)(unsigned short)(data >> 32) / TABLE_DEPTH_SCALE;
+		const int move_loc = (int)((data >> 48) & 0xff);
+		entry.move = (move_loc == NO_MOVE) ? 0x0LL : 0x1ULL << move_loc;
+		entry.bound = (Bound)((data >> 56) & 0x3);
+		entry.rounded = ((data >> 58) & 0x1) != 0;
+		entry.age = age_of(data);
+		return entry;
+	}
+
+	static int depth_of(const BitBoard& data) {
+		return (int)(short)(unsigned short)(data >> 32);
+	}
+
+	static int age_of(const BitBoard& data) {
+		return (int)(data >> 59) & AGE_MASK;
+	}
+
+	static bool is_used(const BitBoard& data) {
+		return ((data >> 56) & 0x3) != (BitBoard)Bound::NONE;
+	}
+
+	Bucket& bucket_of(const BitBoard& key) {
+		return buckets[(size_t)key & mask];
+	}
+
+	int victim(const Bucket& bucket, const BitBoard& key) const {
+		if (replacement == Replacement::ALWAYS) return (int)(key >> 62);
+
+		int out = 0;
+		int worst = INT_MAX;
+		for (int slot = 0; slot < BUCKET_SIZE; ++slot) {
+			const BitBoard data = bucket.data[slot].load(std::memory_order_relaxed);
+			if (!is_used(data)) return slot;
+
+			int worth = depth_of(data);
+			const bool stale = age_of(data) != age;
+			if (replacement == Replacement::AGE_DEPTH && stale) worth -= 1 << 16;
+			if (worth < worst) {
+				worst = worth;
+				out = slot;
+			}
+		}
+		return out;
+	}
+
+public:
+	// `size_mb` MB rounded down to a power of two of buckets; 0 disables the table.
+	TranspositionTable(const size_t size_mb = 0, const Replacement replacement_ = Replacement::AGE_DEPTH)
+		: replacement(replacement_) {
+		resize(size_mb);
+	}
+
+	void resize(const size_t size_mb) {
+		size_t n = 0;
+		if (size_mb > 0) {
+			n = 1;
+			while (2 * n * sizeof(Bucket) <= size_mb * 1024 * 1024) n *= 2;
+		}
+		storage.reset((n > 0) ? new char[n * sizeof(Bucket) + CACHE_LINE] : nullptr);
+		buckets = nullptr;
+		if (n > 0) {
+			void* start = storage.get();
+			size_t space = n * sizeof(Bucket) + CACHE_LINE;
+			buckets = static_cast<Bucket*>(std::align(CACHE_LINE, n * sizeof(Bucket), start, space));
+			for (size_t idx = 0; idx < n; ++idx) new (&buckets[idx]) Bucket;
+		}
+		num_buckets = n;
+		mask = (n > 0) ? n - 1 : 0;
+		clear();
+	}
+
+	void set_replacement(const Replacement replacement_) { replacement = replacement_; }
+
+	bool enabled() const { return num_buckets > 0; }
+
+	size_t size_bytes() const { return num_buckets * sizeof(Bucket); }
+
+	void clear() {
+		for (size_t idx = 0; idx < num_buckets; ++idx) {
+			Bucket& bucket = buckets[idx];
+			for (int slot = 0; slot < BUCKET_SIZE; ++slot) {
+				bucket.data[slot].store(0x0LL, std::memory_order_relaxed);
+				bucket.check[slot].store(0x0LL, std::memory_order_relaxed);
+			}
+		}
+		age = 0;
+	}
+
+	// Called once per search: entries written before are aged and replaced first.
+	void new_search() {
+		age = (age + 1) & AGE_MASK;
+	}
+
+	bool probe(const BitBoard& key, TableEntry& entry) {
+		if (!enabled()) return false;
+		Bucket& bucket = bucket_of(key);
+		for (int slot = 0; slot < BUCKET_SIZE; ++slot) {
+			const BitBoard data = bucket.data[slot].load(std::memory_order_relaxed);
+			const BitBoard check = bucket.check[slot].load(std::memory_order_relaxed);
+			if ((check ^ data) == key && is_used(data)) {
+				entry = unpack(data);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void store(const BitBoard& key, const double value, const double depth, const Bound bound, const BitBoard& move) {
+		if (!enabled()) return;
+		Bucket& bucket = bucket_of(key);
+
+		int slot = -1;
+		for (int idx = 0; idx < BUCKET_SIZE; ++idx) {
+			const BitBoard data = bucket.data[idx].load(std::memory_order_relaxed);
+			if ((bucket.check[idx].load(std::memory_order_relaxed) ^ data) == key && is_used(data)) {
+				// a shallower result from the current search does not overwrite a deeper one
+				if (replacement != Replacement::ALWAYS && depth_of(data) > table_depth(depth) && age_of(data) == age) return;
+				slot = idx;
+				break;
+			}
+		}
+		if (slot < 0) slot = victim(bucket, key);
+
+		const BitBoard data = pack(value, depth, bound, move, age);
+		bucket.data[slot].store(data, std::memory_order_relaxed);
+		bucket.check[slot].store(key ^ data, std::memory_order_relaxed);
+	}
+};
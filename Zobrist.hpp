@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Board.hpp"
+
+/**
+Zobrist hashing
+
+A position is hashed as the XOR of one random key per stone, with separate keys for the stones of
+the player to move and of the opponent. The keys are generated from a fixed seed, so a hash is the
+same from run to run and can be stored (books, datasets).
+
+Boards are relative to the player to move, so a move exchanges the roles of the two colours.
+ZobristKey therefore also keeps the hash with the colours exchanged: a move only XORs the keys of
+the placed and the flipped stones into it, and a pass just swaps the two hashes.
+*/
+
+class Zobrist {
+private:
+	static constexpr int NUM_BYTES = BOARD_AREA / 8;
+
+	BitBoard keys[2][BOARD_AREA];		// [0] player to move, [1] opponent
+	BitBoard flip_keys[BOARD_AREA];		// keys[0] ^ keys[1]
+	BitBoard byte_keys[2][NUM_BYTES][256];	// XOR of the keys of the stones in one byte of the board
+
+	// splitmix64
+	static BitBoard next_key(BitBoard& state) {
+		BitBoard z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	BitBoard hash_stones(const int side, const BitBoard& stones) const {
+		BitBoard out = 0x0LL;
+		for (int n = 0; n < NUM_BYTES; ++n) {
+			out ^= byte_keys[side][n][(stones >> (8 * n)) & 0xff];
+		}
+		return out;
+	}
+
+public:
+	Zobrist() {
+		BitBoard state = 0x5245564552534931ULL;
+		for (int side = 0; side < 2; ++side) {
+			for (int loc = 0; loc < BOARD_AREA; ++loc) {
+				keys[side][loc] = next_key(state);
+			}
+		}
+		for (int loc = 0; loc < BOARD_AREA; ++loc) {
+			flip_keys[loc] = keys[0][loc] ^ keys[1][loc];
+		}
+		for (int side = 0; side < 2; ++side) {
+			for (int n = 0; n < NUM_BYTES; ++n) {
+				for (int bits = 0; bits < 256; ++bits) {
+					byte_keys[side][n][bits] = 0x0LL;
+					for (int k = 0; k < 8; ++k) {
+						if ((bits >> k) & 1) byte_keys[side][n][bits] ^= keys[side][8 * n + k];
+					}
+				}
+			}
+		}
+	}
+
+	BitBoard hash(const BitBoard& self, const BitBoard& opponent) const {
+		return hash_stones(0, self) ^ hash_stones(1, opponent);
+	}
+
+	BitBoard hash(const Board& board) const {
+		return hash(board.get_self(), board.get_opponent());
+	}
+
+	BitBoard self_key(const BitBoard& move) const {
+		return keys[0][lsb_loc(move)];
+	}
+
+	BitBoard opponent_key(const BitBoard& move) const {
+		return keys[1][lsb_loc(move)];
+	}
+
+	// XOR of keys[0] ^ keys[1] over `stones`: moves them from one colour to the other.
+	BitBoard flip_key(BitBoard stones) const {
+		BitBoard out = 0x0LL;
+		for (; !is_empty(stones); stones &= stones - 1) {
+			out ^= flip_keys[lsb_loc(stones)];
+		}
+		return out;
+	}
+};
+
+static const Zobrist zobrist;
+
+struct ZobristKey {
+	// left uninitialized by default, like the plies of a SearchBoard which hold one
+	BitBoard key;		// hash of the position
+	BitBoard swapped;	// hash with the colours exchanged, i.e. of the position after a pass
+
+	ZobristKey() = default;
+
+	ZobristKey(const BitBoard& key_, const BitBoard& swapped_) : key(key_), swapped(swapped_) {};
+
+	ZobristKey(const Board& board)
+		: key(zobrist.hash(board.get_self(), board.get_opponent())),
+		swapped(zobrist.hash(board.get_opponent(), board.get_self())) {};
+
+	// Key of the position after the player to move plays `move`, flipping `flipped`.
+	// An empty `move` is a pass.
+	ZobristKey play(const BitBoard& move, const BitBoard& flipped) const {
+		if (is_empty(move)) return pass();
+		const BitBoard flip = zobrist.flip_key(flipped);
+		return ZobristKey(swapped ^ flip ^ zobrist.opponent_key(move), key ^ flip ^ zobrist.self_key(move));
+	}
+
+	ZobristKey pass() const {
+		return ZobristKey(swapped, key);
+	}
+};
+
+inline Board transform(const Board& board, const int symmetry) {
+	return Board(transform(board.get_self(), symmetry), transform(board.get_opponent(), symmetry));
+}
+
+// The smallest of the 8 symmetric images of `board`, and the symmetry which gives it.
+// Symmetric positions share the same canonical board and hash.
+inline Board canonical(const Board& board, int& symmetry) {
+	Board best = board;
+	symmetry = 0;
+	for (int sym = 1; sym < NUM_SYMMETRIES; ++sym) {
+		const Board image = transform(board, sym);
+		if (image.get_self() < best.get_self() || (image.get_self() == best.get_self() && image.get_opponent() < best.get_opponent())) {
+			best = image;
+			symmetry = sym;
+		}
+	}
+	return best;
+}
+
+inline Board canonical(const Board& board) {
+	int symmetry = 0;
+	return canonical(board, symmetry);
+}
+
+inline BitBoard canonical_hash(const Board& board) {
+	return zobrist.hash(canonical(board));
+}
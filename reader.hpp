@@ -4,12 +4,54 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <iterator>
 
 #include "Game.hpp"
 #include "Feature.hpp"
 
 constexpr int OFFSET_BYTES = 16;
 constexpr int ONE_GAME_BYTES = 68;
+constexpr int GAME_HEADER_BYTES = 8;
+
+// A move of a WTHOR game record: 10 * column + row, both from 1, or 0 for none.
+inline Cell wthor_cell(const unsigned char byte) {
+	if (byte == 0) return Cell::Pass();
+	return Cell((int)(byte / 10) - 1, byte % 10 - 1);
+}
+
+// The positions of each game of the WTHOR file `path`, from the initial position to the end of
+// the game, each relative to its player to move. Empty if the file cannot be read.
+inline std::vector<std::vector<Board>> read_wthor_games(const std::string& path) {
+	std::vector<std::vector<Board>> out;
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return out;
+
+	const std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (bytes.size() < OFFSET_BYTES) return out;
+
+	const size_t num_games = (bytes.size() - OFFSET_BYTES) / ONE_GAME_BYTES;
+	for (size_t id = 0; id < num_games; ++id) {
+		auto it = bytes.begin() + OFFSET_BYTES + ONE_GAME_BYTES * id + GAME_HEADER_BYTES;
+		const auto end = bytes.begin() + OFFSET_BYTES + ONE_GAME_BYTES * (id + 1);
+
+		Game game;
+		std::vector<Board> positions = { game.get_board() };
+		while (!game.is_game_over()) {
+			if (game.has_valid_move()) {
+				if (it == end) break;
+				const Cell move = wthor_cell(*it++);
+				if (move.is_pass() || !game.is_valid_move(move)) break;
+				game.play(move);
+			}
+			else {
+				game.pass();
+			}
+			positions.push_back(game.get_board());
+		}
+		out.push_back(positions);
+	}
+	return out;
+}
 
 
 struct WthorTransformer {
@@ -28,15 +70,14 @@ private:
 	}
 
 	Cell byte_to_cell(const Byte& byte) {
-		if (byte == 0) return Cell::Pass();
-		return Cell((int)(byte / 10) - 1, byte % 10 - 1);
+		return wthor_cell(byte);
 	}
 
 	void transform_game(const std::vector<Byte>& bytes, const size_t game_id, const Player evaluator, const std::string& output_file) {
 		const size_t offset = OFFSET_BYTES + ONE_GAME_BYTES * game_id;
 		auto it = bytes.begin() + offset;
 
-		it = it + 8;
+		it = it + GAME_HEADER_BYTES;
 
 		std::vector<std::string> features_list;
 